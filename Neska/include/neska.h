@@ -0,0 +1,108 @@
+/* neska.h - C ABI for embedding the Neska NES emulator.
+ *
+ * Every function is safe to call on different machines from different
+ * threads; a single machine must not be used from two threads at once.
+ * Pointers returned by the accessors stay valid until the machine is
+ * destroyed or a new ROM is loaded, and always show the live state.
+ */
+#ifndef NESKA_H
+#define NESKA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(NESKA_BUILDING_LIBRARY)
+#    define NESKA_API __declspec(dllexport)
+#  else
+#    define NESKA_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define NESKA_API __attribute__((visibility("default")))
+#else
+#  define NESKA_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a signature or struct layout below changes. */
+#define NESKA_ABI_VERSION 1
+
+#define NESKA_SCREEN_WIDTH  256
+#define NESKA_SCREEN_HEIGHT 240
+
+/* Controller bits, one byte per frame per port. */
+#define NESKA_BUTTON_A      0x01
+#define NESKA_BUTTON_B      0x02
+#define NESKA_BUTTON_SELECT 0x04
+#define NESKA_BUTTON_START  0x08
+#define NESKA_BUTTON_UP     0x10
+#define NESKA_BUTTON_DOWN   0x20
+#define NESKA_BUTTON_LEFT   0x40
+#define NESKA_BUTTON_RIGHT  0x80
+
+typedef enum neska_result {
+    NESKA_OK            =  0,
+    NESKA_ERR_ARGUMENT  = -1,  /* null machine/buffer or bad size */
+    NESKA_ERR_ROM       = -2,  /* ROM image could not be parsed */
+    NESKA_ERR_NO_ROM    = -3,  /* operation needs a loaded ROM */
+    NESKA_ERR_STATE     = -4   /* snapshot does not match this machine */
+} neska_result;
+
+typedef struct neska_machine neska_machine;
+
+/* One entry of a batched step: run 'frames' frames on 'machine'. */
+typedef struct neska_step_request {
+    neska_machine* machine;
+    const uint8_t* inputs;   /* 'frames' controller bytes, or NULL to hold */
+    uint32_t       frames;
+    uint8_t*       ram_out;  /* optional: frames * 2048 bytes of RAM, one
+                                copy after each frame, or NULL */
+    int32_t        result;   /* filled in by neska_step_batch */
+} neska_step_request;
+
+NESKA_API uint32_t neska_abi_version(void);
+
+NESKA_API neska_machine* neska_create(void);
+NESKA_API void           neska_destroy(neska_machine* machine);
+
+/* Parse an iNES image from memory (copied) and power the machine on. */
+NESKA_API int neska_load_rom(neska_machine* machine, const uint8_t* data, size_t size);
+
+/* Power-cycle with internal RAM filled with 'ram_fill'. */
+NESKA_API int neska_power_on(neska_machine* machine, uint8_t ram_fill);
+
+/* Run 'frames' frames. 'inputs' holds one controller byte per frame and may
+ * be NULL to keep the current buttons. 'ram_out', if given, receives a copy
+ * of the 2 KB RAM after every frame (frames * 2048 bytes). */
+NESKA_API int neska_step(neska_machine* machine, const uint8_t* inputs,
+                         uint32_t frames, uint8_t* ram_out);
+
+/* Two-player variant of neska_step: 'inputs' holds two bytes per frame,
+ * port 0 ($4016) then port 1 ($4017), so frames * 2 bytes in all. */
+NESKA_API int neska_step2(neska_machine* machine, const uint8_t* inputs,
+                          uint32_t frames, uint8_t* ram_out);
+
+/* Run several requests with one call; each request's 'result' is set and
+ * the first failure (or NESKA_OK) is returned. */
+NESKA_API int neska_step_batch(neska_step_request* requests, size_t count);
+
+NESKA_API uint64_t neska_frame_count(const neska_machine* machine);
+
+/* Zero-copy views of live state. */
+NESKA_API const uint32_t* neska_framebuffer(const neska_machine* machine); /* 256x240 ARGB8888 */
+NESKA_API uint8_t*        neska_ram(neska_machine* machine, size_t* size); /* 2 KB */
+NESKA_API uint8_t*        neska_prg_ram(neska_machine* machine, size_t* size);
+
+/* Snapshots into caller-provided memory. Sizes depend on the loaded ROM. */
+NESKA_API size_t neska_state_size(const neska_machine* machine);
+NESKA_API int    neska_save_state(const neska_machine* machine, void* buffer, size_t size);
+NESKA_API int    neska_load_state(neska_machine* machine, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NESKA_H */
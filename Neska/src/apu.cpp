@@ -0,0 +1,547 @@
+// apu.cpp
+#include "apu.h"
+#include "cpu.h"
+#include "memory.h"
+
+#include <algorithm>
+
+// ===========================
+// Tables (NTSC)
+// ===========================
+static const uint8_t LENGTH_TABLE[32] = {
+    10, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
+    12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const uint8_t DUTY_TABLE[4][8] = {
+    { 0, 1, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 1, 1, 0, 0, 0 },
+    { 1, 0, 0, 1, 1, 1, 1, 1 }
+};
+
+static const uint8_t TRIANGLE_TABLE[32] = {
+    15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15
+};
+
+// In CPU cycles
+static const uint16_t NOISE_PERIODS[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+static const uint16_t DMC_RATES[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// Frame counter steps, in CPU cycles after the sequence starts. The last
+// step of each sequence clocks the half-frame units as well; the 4-step
+// sequence also raises the frame IRQ there.
+static const uint32_t FRAME_STEPS[2][4] = {
+    { 7457, 14913, 22371, 29829 },
+    { 7457, 14913, 22371, 37281 }
+};
+static const uint32_t FRAME_LENGTH[2] = { 29830, 37282 };
+
+// Nonlinear DAC mix of the five channel levels, 0.0 to about 1.0. The
+// DAC's response depends only on the pulse sum (0-30) and on the weighted
+// sum 3*triangle + 2*noise + dmc (0-202), so two small tables replace the
+// divisions.
+struct MixTables {
+    float pulse[31];
+    float tnd[203];
+
+    MixTables() {
+        pulse[0] = tnd[0] = 0.0f;
+        for (int n = 1; n < 31; ++n) pulse[n] = 95.52f / (8128.0f / float(n) + 100.0f);
+        for (int n = 1; n < 203; ++n) tnd[n] = 163.67f / (24329.0f / float(n) + 100.0f);
+    }
+};
+
+static const MixTables MIX_TABLES;
+
+static inline float mixLevels(int pulse1, int pulse2, int tri, int noise, int dmc) {
+    return MIX_TABLES.pulse[pulse1 + pulse2] + MIX_TABLES.tnd[3 * tri + 2 * noise + dmc];
+}
+
+void APU::Envelope::clock() {
+    if (start) {
+        start = false;
+        decay = 15;
+        divider = period;
+    }
+    else if (divider == 0) {
+        divider = period;
+        if (decay > 0) decay--;
+        else if (loop) decay = 15;
+    }
+    else {
+        divider--;
+    }
+}
+
+APU::APU()
+    : cpu(nullptr), memory(nullptr), scheduler(nullptr), channelEnable(0),
+    fiveStep(false), irqInhibit(false), frameIrq(false), dmcIrq(false),
+    frameStep(0), frameStart(0), frameEvent(0), clock(0), cpuDeadline(NEVER),
+    outputRate(0), blipFrameStart(0), lastMix(0)
+{
+    restartFrameCounter(0);
+}
+
+void APU::setSampleRate(int rate) {
+    outputRate = rate;
+    if (rate > 0) blip.setRates(CPU_CLOCK_NTSC, rate);
+    blipFrameStart = clock;
+    lastMix = 0;
+    updateOutput();
+}
+
+void APU::reset() {
+    pulse[0] = Pulse();
+    pulse[1] = Pulse();
+    triangle = Triangle();
+    noise = Noise();
+    dmc = DMC();
+    channelEnable = 0;
+    fiveStep = false;
+    irqInhibit = false;
+    frameIrq = false;
+    dmcIrq = false;
+
+    clock = cpu ? cpu->totalCycles : 0;
+    blipFrameStart = clock;
+    restartFrameCounter(clock);
+    updateChannels();
+    updateOutput();
+    updateCpuEvents();
+}
+
+// ===========================
+// Catch-up
+// ===========================
+void APU::run(uint64_t cycle) {
+    for (;;) {
+        uint64_t next = std::min({ frameEvent, pulse[0].next, pulse[1].next,
+            triangle.next, noise.next, dmc.next });
+        if (next > cycle) break;
+
+        clock = next;
+        if (frameEvent == next) clockFrameCounter();
+        clockTimers(next);
+        updateOutput();
+    }
+    if (cycle > clock) clock = cycle;
+    updateCpuEvents();
+}
+
+void APU::clockTimers(uint64_t at) {
+    for (Pulse& p : pulse) {
+        if (p.next != at) continue;
+        p.phase = (p.phase + 1) & 7;
+        p.output = DUTY_TABLE[p.duty][p.phase] ? p.env.volume() : 0;
+        p.next += (uint64_t(p.period) + 1) * 2;
+    }
+    if (triangle.next == at) {
+        triangle.step = (triangle.step + 1) & 31;
+        triangle.output = TRIANGLE_TABLE[triangle.step];
+        triangle.next += uint64_t(triangle.period) + 1;
+    }
+    if (noise.next == at) {
+        uint16_t feedback = (noise.shift ^ (noise.shift >> (noise.mode ? 6 : 1))) & 1;
+        noise.shift = uint16_t((noise.shift >> 1) | (feedback << 14));
+        noise.output = (noise.shift & 1) ? 0 : noise.env.volume();
+        noise.next += NOISE_PERIODS[noise.periodIndex];
+    }
+    if (dmc.next == at) {
+        if (!dmc.silence) {
+            if (dmc.shifter & 1) {
+                if (dmc.level <= 125) dmc.level += 2;
+            }
+            else if (dmc.level >= 2) {
+                dmc.level -= 2;
+            }
+        }
+        dmc.shifter >>= 1;
+        if (--dmc.bitsRemaining == 0) {
+            dmc.bitsRemaining = 8;
+            dmc.silence = !dmc.bufferFull;
+            if (dmc.bufferFull) {
+                dmc.shifter = dmc.buffer;
+                dmc.bufferFull = false;
+                fetchSample();
+            }
+        }
+        dmc.next += DMC_RATES[dmc.rateIndex];
+        updateDMC();
+    }
+}
+
+void APU::restartFrameCounter(uint64_t at) {
+    frameStart = at;
+    frameStep = 0;
+    frameEvent = at + FRAME_STEPS[fiveStep][0];
+}
+
+void APU::clockFrameCounter() {
+    quarterFrame();
+    if (frameStep == 1 || frameStep == 3) halfFrame();
+    if (frameStep == 3 && !fiveStep && !irqInhibit) frameIrq = true;
+
+    if (++frameStep == 4) {
+        frameStep = 0;
+        frameStart += FRAME_LENGTH[fiveStep];
+    }
+    frameEvent = frameStart + FRAME_STEPS[fiveStep][frameStep];
+    updateChannels();
+}
+
+void APU::quarterFrame() {
+    pulse[0].env.clock();
+    pulse[1].env.clock();
+    noise.env.clock();
+
+    if (triangle.linearReload) triangle.linear = triangle.linearPeriod;
+    else if (triangle.linear > 0) triangle.linear--;
+    if (!triangle.control) triangle.linearReload = false;
+}
+
+void APU::halfFrame() {
+    for (int i = 0; i < 2; ++i) {
+        Pulse& p = pulse[i];
+        if (!p.env.loop && p.length > 0) p.length--;
+
+        int target = p.sweepTarget(i == 1);
+        if (p.sweepDivider == 0 && p.sweepEnabled && p.sweepShift > 0 &&
+            p.period >= 8 && target <= 0x7FF) {
+            p.period = uint16_t(target);
+        }
+        if (p.sweepDivider == 0 || p.sweepReload) {
+            p.sweepDivider = p.sweepPeriod;
+            p.sweepReload = false;
+        }
+        else {
+            p.sweepDivider--;
+        }
+    }
+    if (!triangle.control && triangle.length > 0) triangle.length--;
+    if (!noise.env.loop && noise.length > 0) noise.length--;
+}
+
+// ===========================
+// Channel scheduling
+// ===========================
+// A channel that cannot be heard schedules no timer events; its timer
+// restarts from a full period when it becomes audible again.
+
+// Pulse 1 negates in ones' complement, pulse 2 in two's complement.
+int APU::Pulse::sweepTarget(bool second) const {
+    int change = period >> sweepShift;
+    if (!sweepNegate) return period + change;
+    return period - change - (second ? 0 : 1);
+}
+
+void APU::updateChannels() {
+    updatePulse(pulse[0], false);
+    updatePulse(pulse[1], true);
+    updateTriangle();
+    updateNoise();
+    updateDMC();
+}
+
+void APU::updatePulse(Pulse& p, bool second) {
+    bool audible = p.length > 0 && p.period >= 8 && p.sweepTarget(second) <= 0x7FF &&
+        p.env.volume() > 0;
+    if (!audible) {
+        p.output = 0;
+        p.next = NEVER;
+        return;
+    }
+    p.output = DUTY_TABLE[p.duty][p.phase] ? p.env.volume() : 0;
+    if (p.next == NEVER) p.next = clock + (uint64_t(p.period) + 1) * 2;
+}
+
+void APU::updateTriangle() {
+    // Periods below 2 are ultrasonic; hold the level instead of aliasing
+    bool running = triangle.length > 0 && triangle.linear > 0 && triangle.period >= 2;
+    triangle.output = TRIANGLE_TABLE[triangle.step];
+    if (!running) triangle.next = NEVER;
+    else if (triangle.next == NEVER) triangle.next = clock + triangle.period + 1;
+}
+
+void APU::updateNoise() {
+    bool audible = noise.length > 0 && noise.env.volume() > 0;
+    if (!audible) {
+        noise.output = 0;
+        noise.next = NEVER;
+        return;
+    }
+    noise.output = (noise.shift & 1) ? 0 : noise.env.volume();
+    if (noise.next == NEVER) noise.next = clock + NOISE_PERIODS[noise.periodIndex];
+}
+
+void APU::updateDMC() {
+    // Idle once the last byte has been shifted out and nothing is queued
+    bool idle = dmc.silence && !dmc.bufferFull && dmc.bytesRemaining == 0 &&
+        dmc.bitsRemaining == 8;
+    if (idle) dmc.next = NEVER;
+    else if (dmc.next == NEVER) dmc.next = clock + DMC_RATES[dmc.rateIndex];
+}
+
+void APU::fetchSample() {
+    if (dmc.bufferFull || dmc.bytesRemaining == 0 || !memory) return;
+
+    dmc.buffer = memory->read(dmc.address);
+    dmc.bufferFull = true;
+    if (cpu) cpu->dmcStall();  // the fetch holds the CPU off the bus
+    dmc.address = dmc.address == 0xFFFF ? 0x8000 : uint16_t(dmc.address + 1);
+
+    if (--dmc.bytesRemaining == 0) {
+        if (dmc.loop) {
+            dmc.address = dmc.sampleAddress;
+            dmc.bytesRemaining = dmc.sampleLength;
+        }
+        else if (dmc.irqEnabled) {
+            dmcIrq = true;
+        }
+    }
+}
+
+void APU::updateCpuEvents() {
+    if (cpu) {
+        cpu->setIrq(IRQ_APU_FRAME, frameIrq);
+        cpu->setIrq(IRQ_DMC, dmcIrq);
+    }
+
+    cpuDeadline = NEVER;
+    if (!fiveStep && !irqInhibit && !frameIrq) {
+        cpuDeadline = frameStart + FRAME_STEPS[0][3];
+    }
+    // The next fetch happens when the output unit empties the buffer
+    if (dmc.bufferFull && dmc.bytesRemaining > 0 && dmc.next != NEVER) {
+        uint64_t period = DMC_RATES[dmc.rateIndex];
+        cpuDeadline = std::min(cpuDeadline, dmc.next + (dmc.bitsRemaining - 1) * period);
+    }
+    if (dmc.irqEnabled && !dmc.loop && !dmcIrq && dmc.bytesRemaining > 0 && dmc.next != NEVER) {
+        // The last byte is fetched when the output unit starts on the
+        // byte before it
+        uint64_t period = DMC_RATES[dmc.rateIndex];
+        uint64_t last = dmc.next + (dmc.bitsRemaining - 1) * period +
+            (uint64_t(dmc.bytesRemaining) - 1) * 8 * period;
+        cpuDeadline = std::min(cpuDeadline, last);
+    }
+    if (scheduler) scheduler->schedule(EventType::Apu, cpuDeadline);
+}
+
+void APU::updateOutput() {
+    if (outputRate == 0) return;
+    float mix = mixLevels(pulse[0].output, pulse[1].output, triangle.output,
+        noise.output, dmc.level);
+    if (mix != lastMix) {
+        blip.addDelta(uint32_t(clock - blipFrameStart), mix - lastMix);
+        lastMix = mix;
+    }
+}
+
+void APU::endFrame(uint64_t cycle) {
+    run(cycle);
+    if (outputRate > 0) blip.endFrame(uint32_t(clock - blipFrameStart));
+    blipFrameStart = clock;
+}
+
+// ===========================
+// Registers
+// ===========================
+void APU::writeRegister(uint16_t addr, uint8_t value) {
+    if (cpu) run(cpu->totalCycles);
+
+    if (addr < 0x4008) {
+        Pulse& p = pulse[(addr >> 2) & 1];
+        switch (addr & 3) {
+        case 0:
+            p.duty = value >> 6;
+            p.env.loop = (value & 0x20) != 0;
+            p.env.constant = (value & 0x10) != 0;
+            p.env.period = value & 0x0F;
+            break;
+        case 1:
+            p.sweepEnabled = (value & 0x80) != 0;
+            p.sweepPeriod = (value >> 4) & 7;
+            p.sweepNegate = (value & 0x08) != 0;
+            p.sweepShift = value & 7;
+            p.sweepReload = true;
+            break;
+        case 2:
+            p.period = uint16_t((p.period & 0x0700) | value);
+            break;
+        case 3:
+            p.period = uint16_t((p.period & 0x00FF) | ((value & 7) << 8));
+            if (channelEnable & (1 << ((addr >> 2) & 1))) p.length = LENGTH_TABLE[value >> 3];
+            p.phase = 0;
+            p.env.start = true;
+            break;
+        }
+    }
+    else {
+        switch (addr) {
+        case 0x4008:
+            triangle.control = (value & 0x80) != 0;
+            triangle.linearPeriod = value & 0x7F;
+            break;
+        case 0x400A:
+            triangle.period = uint16_t((triangle.period & 0x0700) | value);
+            break;
+        case 0x400B:
+            triangle.period = uint16_t((triangle.period & 0x00FF) | ((value & 7) << 8));
+            if (channelEnable & 0x04) triangle.length = LENGTH_TABLE[value >> 3];
+            triangle.linearReload = true;
+            break;
+        case 0x400C:
+            noise.env.loop = (value & 0x20) != 0;
+            noise.env.constant = (value & 0x10) != 0;
+            noise.env.period = value & 0x0F;
+            break;
+        case 0x400E:
+            noise.mode = (value & 0x80) != 0;
+            noise.periodIndex = value & 0x0F;
+            break;
+        case 0x400F:
+            if (channelEnable & 0x08) noise.length = LENGTH_TABLE[value >> 3];
+            noise.env.start = true;
+            break;
+        case 0x4010:
+            dmc.irqEnabled = (value & 0x80) != 0;
+            dmc.loop = (value & 0x40) != 0;
+            dmc.rateIndex = value & 0x0F;
+            if (!dmc.irqEnabled) dmcIrq = false;
+            break;
+        case 0x4011:
+            dmc.level = value & 0x7F;
+            break;
+        case 0x4012:
+            dmc.sampleAddress = uint16_t(0xC000 | (value << 6));
+            break;
+        case 0x4013:
+            dmc.sampleLength = uint16_t((value << 4) | 1);
+            break;
+        case 0x4015:
+            channelEnable = value & 0x1F;
+            if (!(value & 0x01)) pulse[0].length = 0;
+            if (!(value & 0x02)) pulse[1].length = 0;
+            if (!(value & 0x04)) triangle.length = 0;
+            if (!(value & 0x08)) noise.length = 0;
+            dmcIrq = false;
+            if (!(value & 0x10)) {
+                dmc.bytesRemaining = 0;
+            }
+            else if (dmc.bytesRemaining == 0) {
+                dmc.address = dmc.sampleAddress;
+                dmc.bytesRemaining = dmc.sampleLength;
+                fetchSample();
+            }
+            break;
+        case 0x4017: {
+            fiveStep = (value & 0x80) != 0;
+            irqInhibit = (value & 0x40) != 0;
+            if (irqInhibit) frameIrq = false;
+            // The new sequence starts 3-4 cycles after the write
+            restartFrameCounter(clock + ((clock & 1) ? 4 : 3));
+            if (fiveStep) {
+                quarterFrame();
+                halfFrame();
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    updateChannels();
+    updateOutput();
+    updateCpuEvents();
+}
+
+uint8_t APU::readStatus() {
+    if (cpu) run(cpu->totalCycles);
+
+    uint8_t status = 0;
+    if (pulse[0].length > 0)    status |= 0x01;
+    if (pulse[1].length > 0)    status |= 0x02;
+    if (triangle.length > 0)    status |= 0x04;
+    if (noise.length > 0)       status |= 0x08;
+    if (dmc.bytesRemaining > 0) status |= 0x10;
+    if (frameIrq)               status |= 0x40;
+    if (dmcIrq)                 status |= 0x80;
+
+    frameIrq = false;  // reading acknowledges the frame IRQ
+    updateCpuEvents();
+    return status;
+}
+
+// ===========================
+// Snapshots
+// ===========================
+void APU::saveState(StateWriter& w) const {
+    // Event times relative to 'clock'; the APU may lag the CPU by 'lag'
+    auto rel = [this](uint64_t t) { return t == NEVER ? NEVER : t - clock; };
+    uint64_t lag = cpu ? cpu->totalCycles - clock : 0;
+    w.write(lag);
+
+    for (const Pulse& src : pulse) {
+        Pulse p = src;
+        p.next = rel(p.next);
+        w.write(p);
+    }
+    Triangle t = triangle;
+    t.next = rel(t.next);
+    w.write(t);
+    Noise n = noise;
+    n.next = rel(n.next);
+    w.write(n);
+    DMC d = dmc;
+    d.next = rel(d.next);
+    w.write(d);
+
+    w.write(channelEnable);
+    w.write(fiveStep);
+    w.write(irqInhibit);
+    w.write(frameIrq);
+    w.write(dmcIrq);
+    w.write(frameStep);
+    w.write(int64_t(frameStart - clock));
+}
+
+void APU::loadState(StateReader& r) {
+    uint64_t lag = 0;
+    r.read(lag);
+    clock = (cpu ? cpu->totalCycles : 0) - lag;
+    auto abs = [this](uint64_t t) { return t == NEVER ? NEVER : t + clock; };
+
+    for (Pulse& p : pulse) {
+        r.read(p);
+        p.next = abs(p.next);
+    }
+    r.read(triangle);
+    triangle.next = abs(triangle.next);
+    r.read(noise);
+    noise.next = abs(noise.next);
+    r.read(dmc);
+    dmc.next = abs(dmc.next);
+
+    r.read(channelEnable);
+    r.read(fiveStep);
+    r.read(irqInhibit);
+    r.read(frameIrq);
+    r.read(dmcIrq);
+    r.read(frameStep);
+    int64_t start = 0;
+    r.read(start);
+    frameStart = clock + uint64_t(start);
+    frameEvent = frameStart + FRAME_STEPS[fiveStep][frameStep & 3];
+
+    // The stream continues from the current level to the loaded one
+    blipFrameStart = std::min(blipFrameStart, clock);
+    updateOutput();
+    updateCpuEvents();
+}
@@ -0,0 +1,188 @@
+// apu.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "blipbuffer.h"
+#include "savestate.h"
+#include "scheduler.h"
+
+class CPU;
+class Memory;
+
+// NTSC CPU clock, which also clocks the APU.
+static const double CPU_CLOCK_NTSC = 1789773.0;
+
+// 2A03 audio: two pulse channels, triangle, noise, DMC and the frame
+// counter.
+//
+// The APU is not stepped per CPU cycle. It remembers the cycle it has
+// been emulated up to and catches up to the CPU only when something can
+// observe it: a register write, a $4015 read, the end of a video frame,
+// or the next cycle at which it could raise an IRQ or steal bus cycles
+// for a DMC fetch (nextCpuEvent()). A
+// catch-up jumps from one timer or frame-counter event to the next, and
+// silent channels schedule no events at all, so cost follows what is
+// audible rather than the clock. Output goes to a BlipBuffer as one step
+// per change of the mixed level.
+class APU {
+public:
+    APU();
+
+    void setCPU(CPU* c) { cpu = c; }
+    void setMemory(Memory* m) { memory = m; }
+    void setScheduler(Scheduler* s) { scheduler = s; }
+
+    // Output sample rate in Hz; 0 (the default) keeps emulating the
+    // channels but synthesizes nothing, for headless runs.
+    void setSampleRate(int rate);
+    int  sampleRate() const { return outputRate; }
+
+    // Produce 'ratio' times the nominal number of samples per frame, to
+    // steer a consumer's buffer towards its target fill. Keep it within
+    // about half a percent of 1.0 so the pitch change stays inaudible.
+    void setRateAdjust(double ratio) { blip.setRatio(ratio); }
+
+    // Power-on/reset state: channels silent, frame counter restarted.
+    void reset();
+
+    // $4000-$4013, $4015 and $4017.
+    void    writeRegister(uint16_t addr, uint8_t value);
+    uint8_t readStatus();
+
+    // Emulate up to 'cycle' (a CPU::totalCycles value).
+    void run(uint64_t cycle);
+
+    // Earliest CPU cycle at which the frame counter or DMC could raise an
+    // IRQ, or the DMC fetches its next sample byte (which stalls the CPU).
+    // Every change is posted to the scheduler as EventType::Apu; the
+    // emulator calls run() when it comes due.
+    uint64_t nextCpuEvent() const { return cpuDeadline; }
+
+    // Catch up and close the audio frame; its samples become readable.
+    void   endFrame(uint64_t cycle);
+    size_t samplesAvailable() const { return blip.samplesAvailable(); }
+    size_t readSamples(int16_t* out, size_t count) { return blip.readSamples(out, count); }
+
+    // Snapshot support. Timers are stored relative to the current cycle,
+    // so a state loads into a CPU with a different cycle count.
+    void saveState(StateWriter& w) const;
+    void loadState(StateReader& r);
+
+private:
+    static constexpr uint64_t NEVER = ~uint64_t(0);
+
+    struct Envelope {
+        bool    start = false;
+        bool    loop = false;      // also the length counter halt flag
+        bool    constant = false;
+        uint8_t period = 0;        // also the constant volume
+        uint8_t divider = 0;
+        uint8_t decay = 0;
+
+        uint8_t volume() const { return constant ? period : decay; }
+        void    clock();
+    };
+
+    struct Pulse {
+        Envelope env;
+        uint8_t  duty = 0;
+        uint8_t  phase = 0;
+        uint16_t period = 0;        // 11-bit timer reload
+        uint8_t  length = 0;
+        bool     sweepEnabled = false;
+        bool     sweepNegate = false;
+        bool     sweepReload = false;
+        uint8_t  sweepPeriod = 0;
+        uint8_t  sweepShift = 0;
+        uint8_t  sweepDivider = 0;
+        uint8_t  output = 0;
+        uint64_t next = NEVER;      // CPU cycle of the next timer expiry
+
+        int sweepTarget(bool second) const;
+    };
+
+    struct Triangle {
+        bool     control = false;   // also the length counter halt flag
+        bool     linearReload = false;
+        uint8_t  linearPeriod = 0;
+        uint8_t  linear = 0;
+        uint8_t  length = 0;
+        uint8_t  step = 0;
+        uint16_t period = 0;
+        uint8_t  output = 0;
+        uint64_t next = NEVER;
+    };
+
+    struct Noise {
+        Envelope env;
+        bool     mode = false;
+        uint8_t  periodIndex = 0;
+        uint8_t  length = 0;
+        uint16_t shift = 1;
+        uint8_t  output = 0;
+        uint64_t next = NEVER;
+    };
+
+    struct DMC {
+        bool     irqEnabled = false;
+        bool     loop = false;
+        uint8_t  rateIndex = 0;
+        uint8_t  level = 0;
+        uint16_t sampleAddress = 0xC000;
+        uint16_t sampleLength = 1;
+        uint16_t address = 0xC000;
+        uint16_t bytesRemaining = 0;
+        uint8_t  buffer = 0;
+        bool     bufferFull = false;
+        uint8_t  shifter = 0;
+        uint8_t  bitsRemaining = 8;
+        bool     silence = true;
+        uint64_t next = NEVER;
+    };
+
+    CPU*       cpu;
+    Memory*    memory;
+    Scheduler* scheduler;
+
+    Pulse    pulse[2];
+    Triangle triangle;
+    Noise    noise;
+    DMC      dmc;
+
+    uint8_t  channelEnable;    // $4015 bits 0-4
+
+    // Frame counter
+    bool     fiveStep;
+    bool     irqInhibit;
+    bool     frameIrq;
+    bool     dmcIrq;
+    uint8_t  frameStep;        // next step of the sequence
+    uint64_t frameStart;       // cycle the sequence (re)started
+    uint64_t frameEvent;       // cycle of the next step
+
+    uint64_t clock;            // emulated up to here
+    uint64_t cpuDeadline;
+
+    // Output
+    int        outputRate;
+    BlipBuffer blip;
+    uint64_t   blipFrameStart;
+    float      lastMix;
+
+    void clockTimers(uint64_t at);
+    void clockFrameCounter();
+    void quarterFrame();
+    void halfFrame();
+
+    void updateChannels();
+    void updatePulse(Pulse& p, bool second);
+    void updateTriangle();
+    void updateNoise();
+    void updateDMC();
+    void fetchSample();
+
+    void restartFrameCounter(uint64_t at);
+    void updateCpuEvents();
+    void updateOutput();
+};
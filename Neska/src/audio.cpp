@@ -0,0 +1,115 @@
+// audio.cpp
+#include "audio.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Largest rate change dynamic rate control may apply
+static const double MAX_RATE_DELTA = 0.005;
+// The integral term settles steady clock drift over about two seconds
+static const double DRIFT_GAIN = MAX_RATE_DELTA / 120.0;
+
+AudioOutput::AudioOutput()
+    : stream(nullptr), rate(0), targetFill(0), started(false), stalled(false), ratio(1.0), drift(0.0)
+{
+}
+
+AudioOutput::~AudioOutput() {
+    if (stream) SDL_DestroyAudioStream(stream);
+}
+
+bool AudioOutput::open(int sampleRate, int latencyMs) {
+    rate = sampleRate;
+    targetFill = size_t(sampleRate) * size_t(latencyMs) / 1000;
+    // Room for a couple of late frames on top of the target
+    ring = std::make_unique<AudioRing>(targetFill * 4);
+    scratch.resize(ring->capacity());
+    produced.reserve(ring->capacity());
+
+    // Small device periods keep the part of the latency we do not control short
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, "256");
+    SDL_InitSubSystem(SDL_INIT_AUDIO);
+    SDL_AudioSpec spec = { SDL_AUDIO_S16, 1, sampleRate };
+    stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, feed, this);
+    if (!stream) {
+        std::cerr << "Audio device error:" << SDL_GetError() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void AudioOutput::feed(void* userdata, SDL_AudioStream* stream, int additional, int total) {
+    AudioOutput* self = static_cast<AudioOutput*>(userdata);
+    size_t wanted = size_t(additional) / sizeof(int16_t);
+    while (wanted > 0) {
+        size_t n = std::min(wanted, self->scratch.size());
+        self->ring->pop(self->scratch.data(), n);
+        SDL_PutAudioStreamData(stream, self->scratch.data(), int(n * sizeof(int16_t)));
+        wanted -= n;
+    }
+}
+
+void AudioOutput::submit(APU& apu, bool audioPaced) {
+    produced.resize(apu.samplesAvailable());
+    size_t count = apu.readSamples(produced.data(), produced.size());
+    if (!stream) return;
+
+    size_t before = ring->fill();
+    ring->push(produced.data(), count);
+
+    // The device starts once the ring holds its target, so playback does
+    // not begin with a run of underruns
+    if (!started && ring->fill() >= targetFill) {
+        SDL_ResumeAudioStreamDevice(stream);
+        started = true;
+    }
+
+    // Steer the mid-point of this frame's fill towards the target: a short
+    // ring makes the APU produce slightly more per frame, a long one less.
+    // The proportional term handles jitter, the accumulated one the steady
+    // difference between the emulated and the device clock.
+    if (audioPaced || !started) {
+        ratio = 1.0;
+    }
+    else {
+        double level = double(before) + count / 2.0;
+        double error = std::max(-1.0, std::min(1.0, (double(targetFill) - level) / double(targetFill)));
+        drift = std::max(-MAX_RATE_DELTA, std::min(MAX_RATE_DELTA, drift + error * DRIFT_GAIN));
+        double adjust = error * MAX_RATE_DELTA + drift;
+        ratio = 1.0 + std::max(-MAX_RATE_DELTA, std::min(MAX_RATE_DELTA, adjust));
+    }
+    apu.setRateAdjust(ratio);
+}
+
+bool AudioOutput::waitForAudio(std::chrono::nanoseconds maxWait) {
+    if (!stream || !started) return false;
+    if (stalled) {
+        if (ring->fill() > targetFill) return false;
+        stalled = false;
+        std::cerr << "Audio device resumed, pacing by audio again\n";
+        return true;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + maxWait;
+    while (ring->fill() > targetFill) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            stalled = true;
+            std::cerr << "Audio device stopped playing, pacing by video\n";
+            return false;
+        }
+        SDL_DelayNS(250000);
+    }
+    return true;
+}
+
+AudioStats AudioOutput::stats() const {
+    AudioStats s;
+    if (!ring) return s;
+    s.fill = ring->fill();
+    s.capacity = ring->capacity();
+    s.fillMs = rate ? 1000.0 * double(s.fill) / rate : 0.0;
+    s.ratio = ratio;
+    s.underruns = ring->underruns();
+    s.dropped = ring->dropped();
+    return s;
+}
@@ -0,0 +1,74 @@
+// audio.h
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "apu.h"
+#include "audioring.h"
+
+struct AudioStats {
+    size_t   fill = 0;         // samples waiting in the ring
+    size_t   capacity = 0;
+    double   fillMs = 0;       // the same in milliseconds
+    double   ratio = 1.0;      // current rate adjustment
+    uint64_t underruns = 0;    // device callbacks the ring could not satisfy
+    uint64_t dropped = 0;      // samples discarded because the ring was full
+};
+
+// SDL playback of the APU's output, mono signed 16-bit.
+//
+// Samples travel from the emulation thread to the device callback through
+// an AudioRing. Two ways to keep that ring near its target fill:
+//  - video pacing (default): the emulator runs at its own speed and each
+//    frame nudges the APU's output rate by up to +/-0.5% towards the
+//    target (dynamic rate control), absorbing the drift between the
+//    emulated and the real sample clock;
+//  - audio pacing: waitForAudio() holds the emulation thread until the
+//    device has consumed enough, so the sound card's clock sets the speed
+//    and the rate stays nominal.
+class AudioOutput {
+public:
+    AudioOutput();
+    ~AudioOutput();
+
+    AudioOutput(const AudioOutput&) = delete;
+    AudioOutput& operator=(const AudioOutput&) = delete;
+
+    // Open the default playback device, aiming for 'latencyMs' of audio
+    // queued in the ring; the device adds about 5 ms of its own. Prints
+    // why and returns false if there is none; the emulator then runs
+    // silently.
+    bool open(int sampleRate = 48000, int latencyMs = 20);
+    int  sampleRate() const { return rate; }
+    bool isOpen() const { return stream != nullptr; }
+
+    // Once per frame: move everything the APU has synthesized into the
+    // ring and, unless 'audioPaced', retune the APU's output rate.
+    void submit(APU& apu, bool audioPaced = false);
+
+    // Audio pacing: return true once the ring has drained to its target
+    // fill. Returns false without pacing when there is no playing device,
+    // or when the device has taken nothing for 'maxWait' (removed or
+    // paused); it then keeps returning false at once until the device
+    // drains the ring again, and the caller paces by video meanwhile.
+    bool waitForAudio(std::chrono::nanoseconds maxWait);
+
+    AudioStats stats() const;
+
+private:
+    static void feed(void* userdata, SDL_AudioStream* stream, int additional, int total);
+
+    SDL_AudioStream*     stream;
+    int                  rate;
+    size_t               targetFill;
+    bool                 started;
+    bool                 stalled;    // device stopped draining during waitForAudio
+    double               ratio;
+    double               drift;      // integral part of the rate control
+    std::unique_ptr<AudioRing> ring;
+    std::vector<int16_t> produced;   // emulation thread
+    std::vector<int16_t> scratch;    // device callback
+};
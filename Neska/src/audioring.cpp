@@ -0,0 +1,42 @@
+// audioring.cpp
+#include "audioring.h"
+
+AudioRing::AudioRing(size_t capacity)
+    : lastSample(0), head(0), tail(0), underrunCount(0), droppedCount(0)
+{
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    samples.resize(size);
+    mask = size - 1;
+}
+
+size_t AudioRing::push(const int16_t* in, size_t count) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t room = capacity() - (h - tail.load(std::memory_order_acquire));
+    if (count > room) {
+        droppedCount.fetch_add(count - room, std::memory_order_relaxed);
+        count = room;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        samples[(h + i) & mask] = in[i];
+    }
+    head.store(h + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::pop(int16_t* out, size_t count) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t available = head.load(std::memory_order_acquire) - t;
+    size_t n = available < count ? available : count;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = samples[(t + i) & mask];
+    }
+    tail.store(t + n, std::memory_order_release);
+
+    if (n > 0) lastSample = out[n - 1];
+    if (n < count) {
+        underrunCount.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = n; i < count; ++i) out[i] = lastSample;
+    }
+    return n;
+}
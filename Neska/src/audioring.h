@@ -0,0 +1,46 @@
+// audioring.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Preallocated single-producer/single-consumer ring of mono 16-bit samples
+// between the emulation thread and the audio device callback. Neither side
+// locks or allocates. The producer drops what does not fit and counts it;
+// a consumer asking for more than is queued gets the shortfall padded with
+// the last sample (a held level, not a click) and counts an underrun.
+class AudioRing {
+public:
+    // 'capacity' is rounded up to a power of two.
+    explicit AudioRing(size_t capacity = 1 << 13);
+
+    AudioRing(const AudioRing&) = delete;
+    AudioRing& operator=(const AudioRing&) = delete;
+
+    // Producer. Returns how many samples were stored.
+    size_t push(const int16_t* samples, size_t count);
+
+    // Consumer: write exactly 'count' samples to 'out'. Returns how many
+    // came from the ring.
+    size_t pop(int16_t* out, size_t count);
+
+    // Samples queued; safe from either side.
+    size_t fill() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return mask + 1; }
+
+    uint64_t underruns() const { return underrunCount.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<int16_t> samples;
+    size_t  mask;
+    int16_t lastSample;    // consumer only
+    alignas(64) std::atomic<size_t>   head;
+    alignas(64) std::atomic<size_t>   tail;
+    alignas(64) std::atomic<uint64_t> underrunCount;
+    std::atomic<uint64_t>             droppedCount;
+};
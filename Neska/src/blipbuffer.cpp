@@ -0,0 +1,268 @@
+// blipbuffer.cpp
+#include "blipbuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NESKA_BLIP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Builds single functions for SSE2 or AVX while the rest of the file keeps
+// the baseline target; MSVC needs no annotation.
+#if defined(__GNUC__) || defined(__clang__)
+#define NESKA_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NESKA_TARGET(isa)
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const int PHASES = 32;
+const int TAPS = 16;
+const int PHASE_SHIFT = 32 - 5;   // FRAC_BITS - PHASE_BITS
+
+// Step kernels: for each sub-sample phase, the difference between
+// consecutive output samples of a band-limited unit step. Every phase
+// sums to exactly 1, so a held level integrates back to itself.
+struct StepKernel {
+    alignas(32) float taps[PHASES][TAPS];
+
+    StepKernel() {
+        const double cutoff = 0.45;          // of the output sample rate
+        const double half = TAPS / 2.0;
+        auto impulse = [&](double t) {
+            if (t <= -half || t >= half) return 0.0;
+            double x = 2.0 * PI * cutoff * t;
+            double sinc = t == 0.0 ? 1.0 : std::sin(x) / x;
+            double window = 0.42 + 0.5 * std::cos(PI * t / half) + 0.08 * std::cos(2.0 * PI * t / half);
+            return 2.0 * cutoff * sinc * window;
+        };
+        // Simpson's rule over each one-sample interval
+        auto integrate = [&](double a) {
+            const int steps = 16;
+            double h = 1.0 / steps, sum = impulse(a) + impulse(a + 1.0);
+            for (int k = 1; k < steps; ++k) sum += impulse(a + k * h) * (k & 1 ? 4 : 2);
+            return sum * h / 3.0;
+        };
+
+        for (int p = 0; p < PHASES; ++p) {
+            double frac = double(p) / PHASES;
+            double values[TAPS], total = 0;
+            for (int i = 0; i < TAPS; ++i) {
+                values[i] = integrate(i - half - 1.0 - frac);
+                total += values[i];
+            }
+            for (int i = 0; i < TAPS; ++i) taps[p][i] = float(values[i] / total);
+        }
+    }
+};
+
+const StepKernel& stepKernel() {
+    static const StepKernel kernel;
+    return kernel;
+}
+
+// ---------------------------------------------------------------------
+// Frame rendering: one kernel add per queued step. Steps that would run
+// past the buffer (a frame longer than it) are skipped.
+// ---------------------------------------------------------------------
+using Delta = BlipBuffer::Delta;
+
+void synthScalar(float* buffer, size_t size, uint64_t offset, uint64_t factor,
+    const Delta* deltas, size_t count) {
+    const StepKernel& kernel = stepKernel();
+    for (size_t n = 0; n < count; ++n) {
+        uint64_t pos = offset + deltas[n].time * factor;
+        size_t index = size_t(pos >> 32);
+        if (index + TAPS > size) continue;
+        const float* k = kernel.taps[(pos >> PHASE_SHIFT) & (PHASES - 1)];
+        float* out = buffer + index;
+        float d = deltas[n].delta;
+        for (int i = 0; i < TAPS; ++i) out[i] += k[i] * d;
+    }
+}
+
+#if NESKA_BLIP_X86
+NESKA_TARGET("sse2")
+void synthSSE(float* buffer, size_t size, uint64_t offset, uint64_t factor,
+    const Delta* deltas, size_t count) {
+    const StepKernel& kernel = stepKernel();
+    for (size_t n = 0; n < count; ++n) {
+        uint64_t pos = offset + deltas[n].time * factor;
+        size_t index = size_t(pos >> 32);
+        if (index + TAPS > size) continue;
+        const float* k = kernel.taps[(pos >> PHASE_SHIFT) & (PHASES - 1)];
+        float* out = buffer + index;
+        __m128 d = _mm_set1_ps(deltas[n].delta);
+        for (int i = 0; i < TAPS; i += 4) {
+            __m128 acc = _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_load_ps(k + i), d));
+            _mm_storeu_ps(out + i, acc);
+        }
+    }
+}
+
+NESKA_TARGET("avx")
+void synthAVX(float* buffer, size_t size, uint64_t offset, uint64_t factor,
+    const Delta* deltas, size_t count) {
+    const StepKernel& kernel = stepKernel();
+    for (size_t n = 0; n < count; ++n) {
+        uint64_t pos = offset + deltas[n].time * factor;
+        size_t index = size_t(pos >> 32);
+        if (index + TAPS > size) continue;
+        const float* k = kernel.taps[(pos >> PHASE_SHIFT) & (PHASES - 1)];
+        float* out = buffer + index;
+        __m256 d = _mm256_set1_ps(deltas[n].delta);
+        __m256 lo = _mm256_add_ps(_mm256_loadu_ps(out), _mm256_mul_ps(_mm256_load_ps(k), d));
+        __m256 hi = _mm256_add_ps(_mm256_loadu_ps(out + 8), _mm256_mul_ps(_mm256_load_ps(k + 8), d));
+        _mm256_storeu_ps(out, lo);
+        _mm256_storeu_ps(out + 8, hi);
+    }
+}
+
+bool cpuHasSSE2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpuHasAVX() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;  // OS saves the YMM state
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+bool kernelSupported(BlipKernel kernel) {
+    switch (kernel) {
+    case BlipKernel::Scalar: return true;
+#if NESKA_BLIP_X86
+    case BlipKernel::SSE:    return cpuHasSSE2();
+    case BlipKernel::AVX:    return cpuHasAVX();
+#endif
+    default:                 return false;
+    }
+}
+
+BlipKernel bestKernel() {
+    static const BlipKernel best = kernelSupported(BlipKernel::AVX) ? BlipKernel::AVX
+        : kernelSupported(BlipKernel::SSE) ? BlipKernel::SSE : BlipKernel::Scalar;
+    return best;
+}
+
+} // namespace
+
+BlipBuffer::BlipBuffer()
+    : baseFactor(0), factor(0), offset(0), integrator(0), dcLevel(0), dcRate(0),
+    synth(synthScalar), kernelUsed(BlipKernel::Scalar)
+{
+    static_assert(PHASES == ::PHASES && TAPS == ::TAPS && FRAC_BITS - PHASE_BITS == PHASE_SHIFT,
+        "kernel shape");
+    setKernel(BlipKernel::Auto);
+}
+
+bool BlipBuffer::setKernel(BlipKernel kernel) {
+    if (kernel == BlipKernel::Auto) kernel = bestKernel();
+    if (!kernelSupported(kernel)) return false;
+    switch (kernel) {
+#if NESKA_BLIP_X86
+    case BlipKernel::SSE: synth = synthSSE; break;
+    case BlipKernel::AVX: synth = synthAVX; break;
+#endif
+    default:              synth = synthScalar; break;
+    }
+    kernelUsed = kernel;
+    return true;
+}
+
+const char* BlipBuffer::kernelName(BlipKernel kernel) {
+    switch (kernel) {
+    case BlipKernel::Auto:   return "auto";
+    case BlipKernel::Scalar: return "scalar";
+    case BlipKernel::SSE:    return "SSE2";
+    case BlipKernel::AVX:    return "AVX";
+    }
+    return "?";
+}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate, int bufferMs) {
+    baseFactor = sampleRate / clockRate * double(uint64_t(1) << FRAC_BITS);
+    setRatio(1.0);
+    buffer.assign(size_t(sampleRate * bufferMs / 1000) + TAPS, 0.0f);
+    // One-pole high-pass around 20 Hz
+    dcRate = float(1.0 - std::exp(-2.0 * PI * 20.0 / sampleRate));
+    stepKernel();
+    clear();
+}
+
+void BlipBuffer::setRatio(double ratio) {
+    factor = uint64_t(baseFactor * ratio + 0.5);
+}
+
+void BlipBuffer::clear() {
+    pending.clear();
+    offset = 0;
+    integrator = 0;
+    dcLevel = 0;
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+}
+
+void BlipBuffer::endFrame(uint32_t length) {
+    synth(buffer.data(), buffer.size(), offset, factor, pending.data(), pending.size());
+    pending.clear();
+    offset += length * factor;
+
+    // Nobody is reading: drop the oldest samples, keeping the level they
+    // leave behind
+    size_t limit = buffer.size() - TAPS;
+    if (samplesAvailable() > limit) {
+        size_t drop = samplesAvailable() - limit / 2;
+        for (size_t i = 0; i < drop && i < buffer.size(); ++i) integrator += buffer[i];
+        removeSamples(drop);
+    }
+}
+
+size_t BlipBuffer::readSamples(int16_t* out, size_t count) {
+    count = std::min(count, samplesAvailable());
+    float sum = integrator, dc = dcLevel;
+    for (size_t i = 0; i < count; ++i) {
+        sum += buffer[i];
+        dc += (sum - dc) * dcRate;
+        float s = (sum - dc) * 32767.0f;
+        out[i] = int16_t(std::max(-32768.0f, std::min(32767.0f, s)));
+    }
+    integrator = sum;
+    dcLevel = dc;
+    removeSamples(count);
+    return count;
+}
+
+void BlipBuffer::removeSamples(size_t count) {
+    // Everything past the frame end may still hold kernel tails
+    size_t end = std::min(buffer.size(), samplesAvailable() + TAPS);
+    if (count < end) {
+        std::copy(buffer.begin() + count, buffer.begin() + end, buffer.begin());
+        std::fill(buffer.begin() + (end - count), buffer.begin() + end, 0.0f);
+    }
+    else {
+        std::fill(buffer.begin(), buffer.begin() + end, 0.0f);
+    }
+    offset -= uint64_t(count) << FRAC_BITS;
+}
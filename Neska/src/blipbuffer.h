@@ -0,0 +1,90 @@
+// blipbuffer.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Inner loops available to BlipBuffer. Auto picks the widest one the CPU
+// supports, once, at first use.
+enum class BlipKernel {
+    Auto,
+    Scalar,
+    SSE,     // SSE2, 4 taps per instruction
+    AVX      // AVX, 8 taps per instruction
+};
+
+// Band-limited step synthesizer.
+//
+// Sources describe their output as amplitude steps at input-clock times
+// (CPU cycles for the APU). Each step is drawn into the output-rate buffer
+// as a windowed-sinc step response, so a square wave costs one short
+// kernel add per edge however fast the input clock is, and no aliasing
+// reaches the audible band. Reading integrates the steps and removes DC.
+//
+// The step responses form a polyphase FIR bank (32 sub-sample phases of
+// 16 taps). Steps are only queued while a frame runs; endFrame() renders
+// the whole frame's queue in one pass with the SIMD kernel chosen at
+// runtime, which keeps the filter bank and the output block in cache.
+//
+// Times are relative to the start of the current frame; endFrame() makes
+// everything before the frame's end readable and starts the next one.
+class BlipBuffer {
+public:
+    BlipBuffer();
+
+    // Input clock and output sample rate, in Hz. Clears the buffer. The
+    // buffer holds about 'bufferMs' of output; older samples are dropped
+    // if nobody reads them.
+    void setRates(double clockRate, double sampleRate, int bufferMs = 250);
+
+    // Stretch the output by 'ratio' (1.0 = nominal) without clearing, for
+    // dynamic rate control. Call between frames.
+    void setRatio(double ratio);
+
+    // Add an amplitude step at 'time' input clocks into the frame.
+    void addDelta(uint32_t time, float delta) { pending.push_back({ time, delta }); }
+
+    // Close the frame after 'length' input clocks.
+    void endFrame(uint32_t length);
+
+    size_t samplesAvailable() const { return size_t(offset >> FRAC_BITS); }
+
+    // Copy out up to 'count' signed 16-bit samples; returns how many.
+    size_t readSamples(int16_t* out, size_t count);
+
+    void clear();
+
+    // Force an inner loop, e.g. to benchmark them. Returns false (and
+    // keeps the current one) if this CPU or build lacks it.
+    bool setKernel(BlipKernel kernel);
+    BlipKernel kernel() const { return kernelUsed; }
+    static const char* kernelName(BlipKernel kernel);
+
+    struct Delta {
+        uint32_t time;
+        float    delta;
+    };
+
+private:
+    static const int FRAC_BITS = 32;
+    static const int PHASE_BITS = 5;
+    static const int PHASES = 1 << PHASE_BITS;
+    static const int TAPS = 16;   // kernel width; output lags input by half of it
+
+    using SynthFn = void (*)(float* buffer, size_t size, uint64_t offset, uint64_t factor,
+        const Delta* deltas, size_t count);
+
+    void removeSamples(size_t count);
+
+    double   baseFactor; // output samples per input clock at ratio 1
+    uint64_t factor;     // the same with the ratio applied, 32.32
+    uint64_t offset;     // start of the current frame in output samples, 32.32
+    std::vector<float> buffer;
+    std::vector<Delta> pending;   // steps of the current frame
+    float integrator;
+    float dcLevel;
+    float dcRate;
+    SynthFn    synth;
+    BlipKernel kernelUsed;
+};
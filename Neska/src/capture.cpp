@@ -0,0 +1,345 @@
+// capture.cpp
+#include "capture.h"
+#include "png.h"
+#include "ppu.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+// NTSC NES frame rate: 39375000 / 655171 ~= 60.0988 Hz
+static const uint32_t FPS_NUM = 39375000;
+static const uint32_t FPS_DEN = 655171;
+
+// ----------------
+// Video writers (capture thread only)
+// ----------------
+
+class VideoWriter {
+public:
+    virtual ~VideoWriter() = default;
+    virtual bool writeFrame(const uint32_t* pixels) = 0;
+
+    bool open(const std::string& path) {
+        file.open(path, std::ios::binary);
+        return bool(file);
+    }
+
+protected:
+    std::ofstream file;
+};
+
+namespace {
+
+void putLE16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(uint8_t(v));
+    out.push_back(uint8_t(v >> 8));
+}
+
+void putLE32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(uint8_t(v >> (i * 8)));
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+class Y4MWriter : public VideoWriter {
+public:
+    Y4MWriter() : plane(size_t(SCREEN_WIDTH) * SCREEN_HEIGHT * 3) {}
+
+    bool writeFrame(const uint32_t* pixels) override {
+        if (!headerWritten) {
+            file << "YUV4MPEG2 W" << SCREEN_WIDTH << " H" << SCREEN_HEIGHT
+                 << " F" << FPS_NUM << ":" << FPS_DEN << " Ip A1:1 C444\n";
+            headerWritten = true;
+        }
+
+        // BT.601 limited range, one full-resolution plane per component
+        const size_t n = size_t(SCREEN_WIDTH) * SCREEN_HEIGHT;
+        uint8_t* yPlane = plane.data();
+        uint8_t* uPlane = yPlane + n;
+        uint8_t* vPlane = uPlane + n;
+        for (size_t i = 0; i < n; ++i) {
+            int r = (pixels[i] >> 16) & 0xFF;
+            int g = (pixels[i] >> 8) & 0xFF;
+            int b = pixels[i] & 0xFF;
+            yPlane[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            uPlane[i] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[i] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+
+        file << "FRAME\n";
+        file.write(reinterpret_cast<const char*>(plane.data()), plane.size());
+        return bool(file);
+    }
+
+private:
+    bool headerWritten = false;
+    std::vector<uint8_t> plane;
+};
+
+class RawWriter : public VideoWriter {
+public:
+    bool writeFrame(const uint32_t* pixels) override {
+        file.write(reinterpret_cast<const char*>(pixels),
+            sizeof(uint32_t) * SCREEN_WIDTH * SCREEN_HEIGHT);
+        return bool(file);
+    }
+};
+
+// NKVD layout (little endian):
+//   header: "NKVD", u8 version, u16 width, u16 height, u32 fpsNum, u32 fpsDen
+//   frame:  u32 size, then 'size' bytes of:
+//     u8  flags        bit0 = palette reset, bit1 = raw RGB frame follows
+//     u16 newColors    appended to the palette, 3 bytes RGB each
+//     ops              (varint skip, varint literals, literal indices...)
+//                      until every pixel is covered; skipped pixels keep
+//                      their index from the previous frame.
+class PaletteDeltaWriter : public VideoWriter {
+public:
+    PaletteDeltaWriter()
+        : previous(size_t(SCREEN_WIDTH) * SCREEN_HEIGHT, 0),
+        current(previous.size(), 0) {
+        record.reserve(previous.size() * 2);
+    }
+
+    bool writeFrame(const uint32_t* pixels) override {
+        if (!headerWritten) {
+            std::vector<uint8_t> header;
+            header.insert(header.end(), { 'N', 'K', 'V', 'D', 1 });
+            putLE16(header, SCREEN_WIDTH);
+            putLE16(header, SCREEN_HEIGHT);
+            putLE32(header, FPS_NUM);
+            putLE32(header, FPS_DEN);
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+            headerWritten = true;
+        }
+
+        record.clear();
+        record.push_back(0);            // flags, patched below
+        putLE16(record, 0);             // new colour count, patched below
+
+        uint8_t flags = 0;
+        size_t firstNew = palette.size();
+        if (!indexFrame(pixels, firstNew)) {
+            // Palette would overflow: restart it from this frame.
+            palette.clear();
+            lookup.clear();
+            firstNew = 0;
+            flags |= 0x01;
+            havePrevious = false;
+            if (!indexFrame(pixels, firstNew)) {
+                // More than 256 colours in a single frame; store it verbatim.
+                palette.clear();
+                lookup.clear();
+                record[0] = 0x03;
+                for (size_t i = 0; i < current.size(); ++i) {
+                    record.push_back(uint8_t(pixels[i] >> 16));
+                    record.push_back(uint8_t(pixels[i] >> 8));
+                    record.push_back(uint8_t(pixels[i]));
+                }
+                return flush();
+            }
+        }
+
+        size_t added = palette.size() - firstNew;
+        record[0] = flags;
+        record[1] = uint8_t(added);
+        record[2] = uint8_t(added >> 8);
+        for (size_t i = firstNew; i < palette.size(); ++i) {
+            record.push_back(uint8_t(palette[i] >> 16));
+            record.push_back(uint8_t(palette[i] >> 8));
+            record.push_back(uint8_t(palette[i]));
+        }
+
+        // Delta against the previous frame: runs of unchanged pixels are
+        // skipped, runs of changed pixels are stored as literal indices.
+        const size_t n = current.size();
+        size_t i = 0;
+        while (i < n) {
+            size_t skip = 0;
+            while (havePrevious && i + skip < n && current[i + skip] == previous[i + skip]) ++skip;
+            size_t lit = 0;
+            while (i + skip + lit < n &&
+                (!havePrevious || current[i + skip + lit] != previous[i + skip + lit])) ++lit;
+            putVarint(record, uint32_t(skip));
+            putVarint(record, uint32_t(lit));
+            record.insert(record.end(), current.begin() + i + skip, current.begin() + i + skip + lit);
+            i += skip + lit;
+        }
+
+        previous.swap(current);
+        havePrevious = true;
+        return flush();
+    }
+
+private:
+    // Map every pixel to a palette index, adding new colours as needed.
+    bool indexFrame(const uint32_t* pixels, size_t firstNew) {
+        uint32_t lastColor = 0xFFFFFFFF;
+        uint8_t  lastIndex = 0;
+        for (size_t i = 0; i < current.size(); ++i) {
+            uint32_t rgb = pixels[i] & 0x00FFFFFF;
+            if (rgb != lastColor) {
+                auto it = lookup.find(rgb);
+                if (it == lookup.end()) {
+                    if (palette.size() == 256) {
+                        // roll back colours added by this frame
+                        for (size_t k = firstNew; k < palette.size(); ++k) lookup.erase(palette[k]);
+                        palette.resize(firstNew);
+                        return false;
+                    }
+                    it = lookup.emplace(rgb, uint8_t(palette.size())).first;
+                    palette.push_back(rgb);
+                }
+                lastColor = rgb;
+                lastIndex = it->second;
+            }
+            current[i] = lastIndex;
+        }
+        return true;
+    }
+
+    bool flush() {
+        std::vector<uint8_t> size;
+        putLE32(size, uint32_t(record.size()));
+        file.write(reinterpret_cast<const char*>(size.data()), size.size());
+        file.write(reinterpret_cast<const char*>(record.data()), record.size());
+        return bool(file);
+    }
+
+    bool headerWritten = false;
+    bool havePrevious = false;
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> record;
+    std::vector<uint32_t> palette;
+    std::unordered_map<uint32_t, uint8_t> lookup;
+};
+
+} // namespace
+
+// ----------------
+// FrameCapture
+// ----------------
+
+FrameCapture::FrameCapture(size_t ringSize)
+    : frameSize(size_t(SCREEN_WIDTH) * SCREEN_HEIGHT),
+    frames((ringSize ? ringSize : 1) * frameSize),
+    slots(ringSize ? ringSize : 1),
+    head(0), tail(0),
+    submittedCount(0), writtenCount(0), droppedCount(0), screenshotCount(0),
+    running(true)
+{
+    worker = std::thread(&FrameCapture::workerLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+}
+
+bool FrameCapture::openVideo(const std::string& path, VideoFormat format) {
+    std::unique_ptr<VideoWriter> writer;
+    switch (format) {
+    case VideoFormat::Y4M:          writer = std::make_unique<Y4MWriter>(); break;
+    case VideoFormat::Raw:          writer = std::make_unique<RawWriter>(); break;
+    case VideoFormat::PaletteDelta: writer = std::make_unique<PaletteDeltaWriter>(); break;
+    }
+    if (!writer->open(path)) {
+        std::cerr << "Unable to open capture file: " << path << "\n";
+        return false;
+    }
+    video = std::move(writer);
+    return true;
+}
+
+void FrameCapture::requestScreenshot(const std::string& path) {
+    pendingScreenshot = path;
+}
+
+bool FrameCapture::submitFrame(const uint32_t* frame) {
+    if (!video && pendingScreenshot.empty()) return true;
+
+    submittedCount.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= slots.size()) {
+        // Writer is behind: drop rather than stall emulation. A pending
+        // screenshot stays queued for the next frame that fits.
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    size_t index = size_t(h % slots.size());
+    std::memcpy(&frames[index * frameSize], frame, frameSize * sizeof(uint32_t));
+    Slot& slot = slots[index];
+    slot.video = (video != nullptr);
+    slot.screenshotPath.swap(pendingScreenshot);
+    pendingScreenshot.clear();
+
+    head.store(h + 1, std::memory_order_release);
+    wake.notify_one();
+    return true;
+}
+
+void FrameCapture::close() {
+    if (!running.exchange(false)) return;
+    wake.notify_one();
+    if (worker.joinable()) worker.join();
+    video.reset();
+}
+
+CaptureStats FrameCapture::stats() const {
+    CaptureStats s;
+    s.submitted = submittedCount.load(std::memory_order_relaxed);
+    s.written = writtenCount.load(std::memory_order_relaxed);
+    s.dropped = droppedCount.load(std::memory_order_relaxed);
+    s.screenshots = screenshotCount.load(std::memory_order_relaxed);
+    return s;
+}
+
+void FrameCapture::workerLoop() {
+    for (;;) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            if (!running.load(std::memory_order_acquire)) {
+                // Shutdown requested: re-check so frames published just
+                // before close() are still drained.
+                if (t == head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+
+            // The producer notifies without taking the mutex, so a wakeup
+            // can be missed; the timeout bounds how long that can delay us.
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(5));
+            continue;
+        }
+
+        size_t index = size_t(t % slots.size());
+        process(&frames[index * frameSize], slots[index]);
+        tail.store(t + 1, std::memory_order_release);
+    }
+}
+
+void FrameCapture::process(const uint32_t* pixels, const Slot& slot) {
+    if (slot.video && video) {
+        if (video->writeFrame(pixels)) {
+            writtenCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!slot.screenshotPath.empty()) {
+        if (writePNG(slot.screenshotPath, pixels, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+            screenshotCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            std::cerr << "Unable to write screenshot: " << slot.screenshotPath << "\n";
+        }
+    }
+}
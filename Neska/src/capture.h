@@ -0,0 +1,85 @@
+// capture.h
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// On-disk layouts the capture thread can write.
+enum class VideoFormat {
+    Y4M,          // YUV4MPEG2, 4:4:4, readable by ffmpeg and most players
+    Raw,          // bare 256x240 ARGB8888 frames back to back
+    PaletteDelta  // NKVD: indexed colour + per-frame delta runs (lossless)
+};
+
+struct CaptureStats {
+    uint64_t submitted = 0;    // frames offered by the emulation thread
+    uint64_t written = 0;      // video frames written to disk
+    uint64_t dropped = 0;      // frames rejected because the ring was full
+    uint64_t screenshots = 0;  // PNG files written
+};
+
+class VideoWriter;
+
+// Hands finished framebuffers to a background thread through a bounded
+// single-producer/single-consumer ring. submitFrame() copies one frame and
+// publishes it; it never waits on the writer or the disk. If the ring is
+// full the frame is dropped and counted instead.
+class FrameCapture {
+public:
+    explicit FrameCapture(size_t ringSize = 8);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Start recording video. Must be called before the first submitFrame().
+    bool openVideo(const std::string& path, VideoFormat format);
+
+    // Save the next submitted frame as a PNG.
+    void requestScreenshot(const std::string& path);
+
+    // Emulation thread, once per frame. Returns false if the frame was dropped.
+    bool submitFrame(const uint32_t* frame);
+
+    // Wait for the ring to drain and close the video file.
+    void close();
+
+    CaptureStats stats() const;
+
+private:
+    struct Slot {
+        bool        video = false;
+        std::string screenshotPath;
+    };
+
+    void workerLoop();
+    void process(const uint32_t* pixels, const Slot& slot);
+
+    const size_t frameSize;
+    std::vector<uint32_t> frames;   // ringSize * frameSize pixels
+    std::vector<Slot>     slots;
+
+    // Monotonic counters; slot index is counter % slots.size().
+    std::atomic<uint64_t> head;     // written by the producer
+    std::atomic<uint64_t> tail;     // written by the consumer
+
+    std::unique_ptr<VideoWriter> video;
+    std::string pendingScreenshot;
+
+    std::atomic<uint64_t> submittedCount;
+    std::atomic<uint64_t> writtenCount;
+    std::atomic<uint64_t> droppedCount;
+    std::atomic<uint64_t> screenshotCount;
+
+    std::atomic<bool>       running;
+    std::mutex              wakeMutex;
+    std::condition_variable wake;
+    std::thread             worker;
+};
@@ -0,0 +1,157 @@
+// checksum.cpp
+#include "checksum.h"
+
+#include <cstring>
+
+namespace {
+
+// Slicing-by-8: entries[k][b] is the CRC of byte b followed by k zero
+// bytes, so eight input bytes fold in with eight independent lookups.
+struct Crc32Table {
+    uint32_t entries[8][256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            entries[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                uint32_t prev = entries[k - 1][i];
+                entries[k][i] = (prev >> 8) ^ entries[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+inline uint32_t load32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline uint64_t load64(const uint8_t* p) {
+    return uint64_t(load32(p)) | (uint64_t(load32(p + 4)) << 32);
+}
+
+inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+const Crc32Table crcTable;
+
+} // namespace
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    const auto& t = crcTable.entries;
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo = load32(data) ^ crc;
+        uint32_t hi = load32(data + 4);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--) {
+        crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    // 5552 is the largest block for which the sums cannot overflow 32 bits
+    const uint32_t MOD = 65521;
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t block = size < 5552 ? size : 5552;
+        size -= block;
+        while (block--) {
+            a += *data++;
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+    }
+    return (b << 16) | a;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+    // FNV-1a over 64-bit words, finished with a murmur-style avalanche
+    const uint64_t PRIME = 0x100000001B3ull;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = 0xCBF29CE484222325ull ^ seed;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ word) * PRIME;
+        p += 8;
+        size -= 8;
+    }
+    while (size--) {
+        h = (h ^ *p++) * PRIME;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed) {
+    const uint64_t P1 = 0x9E3779B185EBCA87ull;
+    const uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t P3 = 0x165667B19E3779F9ull;
+    const uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t P5 = 0x27D4EB2F165667C5ull;
+    auto round = [&](uint64_t acc, uint64_t input) {
+        return rotl64(acc + input * P2, 31) * P1;
+    };
+    auto merge = [&](uint64_t h, uint64_t acc) {
+        return (h ^ round(0, acc)) * P1 + P4;
+    };
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        // Four independent lanes keep the multipliers busy
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        while (end - p >= 32) {
+            v1 = round(v1, load64(p));
+            v2 = round(v2, load64(p + 8));
+            v3 = round(v3, load64(p + 16));
+            v4 = round(v4, load64(p + 24));
+            p += 32;
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    }
+    else {
+        h = seed + P5;
+    }
+    h += uint64_t(size);
+
+    while (end - p >= 8) {
+        h = rotl64(h ^ round(0, load64(p)), 27) * P1 + P4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        h = rotl64(h ^ (uint64_t(load32(p)) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    while (p < end) {
+        h = rotl64(h ^ (uint64_t(*p++) * P5), 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,20 @@
+// checksum.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// CRC-32 (IEEE 802.3, as used by PNG, zip and ROM databases). Pass the previous result as
+// 'crc' to continue a running checksum over several buffers.
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// Adler-32 (as used by the zlib stream wrapper).
+uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+// XXH64, bit-compatible with the reference xxHash. Stable, so it can be
+// stored in catalogs and compared across builds.
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+// Fast 64-bit hash for equality checks (frame/RAM fingerprints). Not
+// cryptographic and not stable across versions of this file.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
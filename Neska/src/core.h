@@ -4,7 +4,8 @@ enum class MirrorMode {
     HORIZONTAL,
     VERTICAL,
     FOUR_SCREEN,
-    SINGLE_SCREEN
+    SINGLE_SCREEN,        // every nametable maps to the first page
+    SINGLE_SCREEN_UPPER   // ... or to the second (MMC1, AxROM)
 };
 
 enum class PPUStatusFlag {
@@ -1,28 +1,56 @@
 ﻿// cpu.cpp 
 #include "cpu.h"
+#include "cputrace.h"
 
 // 256-entry instruction table
 Instruction instructionTable[256];
 
 // Macro to set an entry
 #define SET_INS(op, mnem, mode, cyc) \
-    instructionTable[op] = { #mnem, AddrMode::mode, cyc, &CPU::mnem, &CPU::addr_##mode };
+    instructionTable[op] = { #mnem, AddrMode::mode, cyc, &CPU::mnem, &CPU::addr_##mode, false };
+
+// Undocumented opcodes, named the way nestest.log prints them
+#define SET_UNOFFICIAL(op, mnem, mode, cyc, name) \
+    instructionTable[op] = { name, AddrMode::mode, cyc, &CPU::mnem, &CPU::addr_##mode, true };
 
 // Table initializer runs before main()
 struct TableInitializer { TableInitializer() { CPU::initInstructionTable(); } } tableInitializer;
 
 // Constructor
 CPU::CPU(Memory& mem, PPU& ppu)
-    : memory(&mem), ppu(&ppu), PC(0), A(0), X(0), Y(0), SP(0xFD),
-    status(FLAG_UNUSED), cyclesRemaining(0), opcode(0), addr(0), fetched(0),
-    stallCycles(0), nmiRequested(false)
+    : CpuState(), memory(&mem), ppu(&ppu)
 {
+    SP = 0xFD;
+    status = FLAG_UNUSED;
+}
+
+void CPU::saveState(StateWriter& w) const {
+    CpuState state = *this;
+    state.totalCycles &= 1;
+    w.write(state);
+}
+
+void CPU::loadState(StateReader& r) {
+    uint64_t cycles = totalCycles;
+    r.read(static_cast<CpuState&>(*this));
+    uint64_t parity = totalCycles & 1;
+    totalCycles = cycles;
+    if ((totalCycles & 1) != parity) totalCycles++;
 }
 
 void CPU::requestNmi() {
     nmiRequested = true;
 }
 
+void CPU::powerOn() {
+    uint64_t cycles = totalCycles + (totalCycles & 1);  // stays monotonic
+    static_cast<CpuState&>(*this) = CpuState();
+    totalCycles = cycles;
+    SP = 0xFD;
+    status = FLAG_UNUSED;
+    reset();
+}
+
 // Reset CPU and set PC from reset vector
 void CPU::reset() {
     SP = 0xFD;
@@ -44,6 +72,7 @@ void CPU::nmi() {
     uint16_t lo = readByte(0xFFFA);
     uint16_t hi = readByte(0xFFFB);
     PC = (hi << 8) | lo;
+    setFlag(FLAG_INTERRUPT, true);
 
     // NMIs cost 7 cycles total
     cyclesRemaining += 7;
@@ -58,30 +87,31 @@ void CPU::irq() {
     uint16_t lo = readByte(0xFFFE);
     uint16_t hi = readByte(0xFFFF);
     PC = (hi << 8) | lo;
+    setFlag(FLAG_INTERRUPT, true);
 
     // IRQ also costs 7 cycles
     cyclesRemaining += 7;
 }
 
-int CPU::tickCycle() {
-    // 1) If we're in a DMA-stall, just burn one cycle
-    if (stallCycles > 0) {
-        stallCycles--;
-        return 1;
-    }
-
-    int cyclesConsumed = 0;
+void CPU::tickCycle() {
+    totalCycles++;
 
-    // 2) If we just finished the previous instruction, start a new one
+    // 1) If we just finished the previous instruction, start a new one
     if (cyclesRemaining == 0) {
-        // a) Handle any pending NMI (highest priority), then IRQ
+        // a) Handle any pending NMI (highest priority), then IRQ. The entry
+        //    sequence burns its own 7 cycles before the handler's first
+        //    instruction is fetched.
         if (nmiRequested) {
             nmiRequested = false;
             nmi();
         }
-        else {
+        else if (irqLines && !getFlag(FLAG_INTERRUPT)) {
             irq();
         }
+    }
+
+    if (cyclesRemaining == 0) {
+        if (traceRecorder) traceInstruction();
 
         // b) Fetch opcode
         opcode = readByte(PC++);
@@ -105,18 +135,28 @@ int CPU::tickCycle() {
         cyclesRemaining += (this->*ins.operate)();
     }
 
-    // 3) Burn one CPU cycle
+    // 2) Burn one CPU cycle
     cyclesRemaining--;
-    cyclesConsumed++;
+}
 
-    return cyclesConsumed;
+// Capture the state before the instruction at PC runs (nestest convention)
+void CPU::traceInstruction() {
+    CpuTraceRecord r;
+    r.pc = PC;
+    r.bytes[0] = memory->peek(PC);
+    r.bytes[1] = memory->peek(uint16_t(PC + 1));
+    r.bytes[2] = memory->peek(uint16_t(PC + 2));
+    r.a = A; r.x = X; r.y = Y; r.p = status; r.sp = SP;
+    r.scanline = uint16_t(ppu->getScanline());
+    r.dot = uint16_t(ppu->getCycle());
+    traceRecorder->record(r, totalCycles - 1);  // cycles completed before this one
 }
 
 // Initialize table with defaults and specific entries
 void CPU::initInstructionTable() {
     // Default all to illegal
     for (int i = 0; i < 256; i++) {
-        instructionTable[i] = { "ILL", AddrMode::IMP, 2, &CPU::ILL, &CPU::addr_IMP };
+        instructionTable[i] = { "ILL", AddrMode::IMP, 2, &CPU::ILL, &CPU::addr_IMP, true };
     }
     // ADC, SBC, AND, ORA, EOR, CMP, CPX, CPY
     SET_INS(0x69, ADC, IMM, 2); SET_INS(0x65, ADC, ZP, 3); SET_INS(0x75, ADC, ZPX, 4);
@@ -192,133 +232,133 @@ void CPU::initInstructionTable() {
 
     ////////
     // —— Single‐byte “alias” opcodes
-    SET_INS(0x6B, ARR, IMM, 2);
-    SET_INS(0x4B, ASR, IMM, 2);
-    SET_INS(0xAB, ATX, IMM, 2);
-    SET_INS(0xCB, AXS, IMM, 2);
-    SET_INS(0xEB, SBC, IMM, 2);
+    SET_UNOFFICIAL(0x6B, ARR, IMM, 2, "ARR");
+    SET_UNOFFICIAL(0x4B, ASR, IMM, 2, "ASR");
+    SET_UNOFFICIAL(0xAB, ATX, IMM, 2, "ATX");
+    SET_UNOFFICIAL(0xCB, AXS, IMM, 2, "AXS");
+    SET_UNOFFICIAL(0xEB, SBC, IMM, 2, "SBC");
 
     // —— AXA “7th‐bit” AND/store
-    SET_INS(0x9F, AXA, ABY, 5);
-    SET_INS(0x93, AXA, IZY, 6);
+    SET_UNOFFICIAL(0x9F, AXA, ABY, 5, "AXA");
+    SET_UNOFFICIAL(0x93, AXA, IZY, 6, "AXA");
 
     // —— DCP “DEC then CMP”
-    SET_INS(0xC7, DCP, ZP, 5);
-    SET_INS(0xD7, DCP, ZPX, 6);
-    SET_INS(0xCF, DCP, ABS, 6);
-    SET_INS(0xDF, DCP, ABX, 7);
-    SET_INS(0xDB, DCP, ABY, 7);
-    SET_INS(0xC3, DCP, IZX, 8);
-    SET_INS(0xD3, DCP, IZY, 8);
+    SET_UNOFFICIAL(0xC7, DCP, ZP, 5, "DCP");
+    SET_UNOFFICIAL(0xD7, DCP, ZPX, 6, "DCP");
+    SET_UNOFFICIAL(0xCF, DCP, ABS, 6, "DCP");
+    SET_UNOFFICIAL(0xDF, DCP, ABX, 7, "DCP");
+    SET_UNOFFICIAL(0xDB, DCP, ABY, 7, "DCP");
+    SET_UNOFFICIAL(0xC3, DCP, IZX, 8, "DCP");
+    SET_UNOFFICIAL(0xD3, DCP, IZY, 8, "DCP");
 
     // —— ISC “INC then SBC”
-    SET_INS(0xE7, ISC, ZP, 5);
-    SET_INS(0xF7, ISC, ZPX, 6);
-    SET_INS(0xEF, ISC, ABS, 6);
-    SET_INS(0xFF, ISC, ABX, 7);
-    SET_INS(0xFB, ISC, ABY, 7);
-    SET_INS(0xE3, ISC, IZX, 8);
-    SET_INS(0xF3, ISC, IZY, 8);
+    SET_UNOFFICIAL(0xE7, ISC, ZP, 5, "ISB");
+    SET_UNOFFICIAL(0xF7, ISC, ZPX, 6, "ISB");
+    SET_UNOFFICIAL(0xEF, ISC, ABS, 6, "ISB");
+    SET_UNOFFICIAL(0xFF, ISC, ABX, 7, "ISB");
+    SET_UNOFFICIAL(0xFB, ISC, ABY, 7, "ISB");
+    SET_UNOFFICIAL(0xE3, ISC, IZX, 8, "ISB");
+    SET_UNOFFICIAL(0xF3, ISC, IZY, 8, "ISB");
 
     // —— Double‐NOP (“DOP” / “SKB”)
-    SET_INS(0x04, DOP, ZP, 3);
-    SET_INS(0x14, DOP, ZPX, 4);
-    SET_INS(0x34, DOP, ZPX, 4);
-    SET_INS(0x44, DOP, ZP, 3);
-    SET_INS(0x54, DOP, ZPX, 4);
-    SET_INS(0x64, DOP, ZP, 3);
-    SET_INS(0x74, DOP, ZPX, 4);
-    SET_INS(0x80, DOP, IMM, 2);
-    SET_INS(0x82, DOP, IMM, 2);
-    SET_INS(0x89, DOP, IMM, 2);
-    SET_INS(0xC2, DOP, IMM, 2);
-    SET_INS(0xD4, DOP, ZPX, 4);
-    SET_INS(0xE2, DOP, IMM, 2);
-    SET_INS(0xF4, DOP, ZPX, 4);
+    SET_UNOFFICIAL(0x04, DOP, ZP, 3, "NOP");
+    SET_UNOFFICIAL(0x14, DOP, ZPX, 4, "NOP");
+    SET_UNOFFICIAL(0x34, DOP, ZPX, 4, "NOP");
+    SET_UNOFFICIAL(0x44, DOP, ZP, 3, "NOP");
+    SET_UNOFFICIAL(0x54, DOP, ZPX, 4, "NOP");
+    SET_UNOFFICIAL(0x64, DOP, ZP, 3, "NOP");
+    SET_UNOFFICIAL(0x74, DOP, ZPX, 4, "NOP");
+    SET_UNOFFICIAL(0x80, DOP, IMM, 2, "NOP");
+    SET_UNOFFICIAL(0x82, DOP, IMM, 2, "NOP");
+    SET_UNOFFICIAL(0x89, DOP, IMM, 2, "NOP");
+    SET_UNOFFICIAL(0xC2, DOP, IMM, 2, "NOP");
+    SET_UNOFFICIAL(0xD4, DOP, ZPX, 4, "NOP");
+    SET_UNOFFICIAL(0xE2, DOP, IMM, 2, "NOP");
+    SET_UNOFFICIAL(0xF4, DOP, ZPX, 4, "NOP");
 
     // —— RLA “ROL then AND”
-    SET_INS(0x27, RLA, ZP, 5);
-    SET_INS(0x37, RLA, ZPX, 6);
-    SET_INS(0x2F, RLA, ABS, 6);
-    SET_INS(0x3F, RLA, ABX, 7);
-    SET_INS(0x3B, RLA, ABY, 7);
-    SET_INS(0x23, RLA, IZX, 8);
-    SET_INS(0x33, RLA, IZY, 8);
+    SET_UNOFFICIAL(0x27, RLA, ZP, 5, "RLA");
+    SET_UNOFFICIAL(0x37, RLA, ZPX, 6, "RLA");
+    SET_UNOFFICIAL(0x2F, RLA, ABS, 6, "RLA");
+    SET_UNOFFICIAL(0x3F, RLA, ABX, 7, "RLA");
+    SET_UNOFFICIAL(0x3B, RLA, ABY, 7, "RLA");
+    SET_UNOFFICIAL(0x23, RLA, IZX, 8, "RLA");
+    SET_UNOFFICIAL(0x33, RLA, IZY, 8, "RLA");
 
     // —— RRA “ROR then ADC”
-    SET_INS(0x67, RRA, ZP, 5);
-    SET_INS(0x77, RRA, ZPX, 6);
-    SET_INS(0x6F, RRA, ABS, 6);
-    SET_INS(0x7F, RRA, ABX, 7);
-    SET_INS(0x7B, RRA, ABY, 7);
-    SET_INS(0x63, RRA, IZX, 8);
-    SET_INS(0x73, RRA, IZY, 8);
+    SET_UNOFFICIAL(0x67, RRA, ZP, 5, "RRA");
+    SET_UNOFFICIAL(0x77, RRA, ZPX, 6, "RRA");
+    SET_UNOFFICIAL(0x6F, RRA, ABS, 6, "RRA");
+    SET_UNOFFICIAL(0x7F, RRA, ABX, 7, "RRA");
+    SET_UNOFFICIAL(0x7B, RRA, ABY, 7, "RRA");
+    SET_UNOFFICIAL(0x63, RRA, IZX, 8, "RRA");
+    SET_UNOFFICIAL(0x73, RRA, IZY, 8, "RRA");
 
     // —— SLO “ASL then ORA”
-    SET_INS(0x07, SLO, ZP, 5);
-    SET_INS(0x17, SLO, ZPX, 6);
-    SET_INS(0x0F, SLO, ABS, 6);
-    SET_INS(0x1F, SLO, ABX, 7);
-    SET_INS(0x1B, SLO, ABY, 7);
-    SET_INS(0x03, SLO, IZX, 8);
-    SET_INS(0x13, SLO, IZY, 8);
+    SET_UNOFFICIAL(0x07, SLO, ZP, 5, "SLO");
+    SET_UNOFFICIAL(0x17, SLO, ZPX, 6, "SLO");
+    SET_UNOFFICIAL(0x0F, SLO, ABS, 6, "SLO");
+    SET_UNOFFICIAL(0x1F, SLO, ABX, 7, "SLO");
+    SET_UNOFFICIAL(0x1B, SLO, ABY, 7, "SLO");
+    SET_UNOFFICIAL(0x03, SLO, IZX, 8, "SLO");
+    SET_UNOFFICIAL(0x13, SLO, IZY, 8, "SLO");
 
     // —— SRE “LSR then EOR”
-    SET_INS(0x47, SRE, ZP, 5);
-    SET_INS(0x57, SRE, ZPX, 6);
-    SET_INS(0x4F, SRE, ABS, 6);
-    SET_INS(0x5F, SRE, ABX, 7);
-    SET_INS(0x5B, SRE, ABY, 7);
-    SET_INS(0x43, SRE, IZX, 8);
-    SET_INS(0x53, SRE, IZY, 8);
+    SET_UNOFFICIAL(0x47, SRE, ZP, 5, "SRE");
+    SET_UNOFFICIAL(0x57, SRE, ZPX, 6, "SRE");
+    SET_UNOFFICIAL(0x4F, SRE, ABS, 6, "SRE");
+    SET_UNOFFICIAL(0x5F, SRE, ABX, 7, "SRE");
+    SET_UNOFFICIAL(0x5B, SRE, ABY, 7, "SRE");
+    SET_UNOFFICIAL(0x43, SRE, IZX, 8, "SRE");
+    SET_UNOFFICIAL(0x53, SRE, IZY, 8, "SRE");
 
     // —— DCP alias: “SAX” / “LAX”
-    SET_INS(0xA7, LAX, ZP, 3);
-    SET_INS(0xB7, LAX, ZPY, 4);
-    SET_INS(0xAF, LAX, ABS, 4);
-    SET_INS(0xBF, LAX, ABY, 4);
-    SET_INS(0xA3, LAX, IZX, 6);
-    SET_INS(0xB3, LAX, IZY, 5);
+    SET_UNOFFICIAL(0xA7, LAX, ZP, 3, "LAX");
+    SET_UNOFFICIAL(0xB7, LAX, ZPY, 4, "LAX");
+    SET_UNOFFICIAL(0xAF, LAX, ABS, 4, "LAX");
+    SET_UNOFFICIAL(0xBF, LAX, ABY, 4, "LAX");
+    SET_UNOFFICIAL(0xA3, LAX, IZX, 6, "LAX");
+    SET_UNOFFICIAL(0xB3, LAX, IZY, 5, "LAX");
 
     // —— LAR “AND SP with mem, then LDX/LDA/SP”
-    SET_INS(0xBB, LAR, ABY, 4);
+    SET_UNOFFICIAL(0xBB, LAR, ABY, 4, "LAR");
 
     // —— AXA / SHA weird store (7th‐bit)
-    SET_INS(0x9E, SXA, ABY, 5);
-    SET_INS(0x9C, SYA, ABX, 5);
+    SET_UNOFFICIAL(0x9E, SXA, ABY, 5, "SXA");
+    SET_UNOFFICIAL(0x9C, SYA, ABX, 5, "SYA");
 
     // —— Triple‐NOP (“TOP” / “SKW”)
-    SET_INS(0x0C, TOP, ABS, 4);
-    SET_INS(0x1C, TOP, ABX, 4);
-    SET_INS(0x3C, TOP, ABX, 4);
-    SET_INS(0x5C, TOP, ABX, 4);
-    SET_INS(0x7C, TOP, ABX, 4);
-    SET_INS(0xDC, TOP, ABX, 4);
-    SET_INS(0xFC, TOP, ABX, 4);
+    SET_UNOFFICIAL(0x0C, TOP, ABS, 4, "NOP");
+    SET_UNOFFICIAL(0x1C, TOP, ABX, 4, "NOP");
+    SET_UNOFFICIAL(0x3C, TOP, ABX, 4, "NOP");
+    SET_UNOFFICIAL(0x5C, TOP, ABX, 4, "NOP");
+    SET_UNOFFICIAL(0x7C, TOP, ABX, 4, "NOP");
+    SET_UNOFFICIAL(0xDC, TOP, ABX, 4, "NOP");
+    SET_UNOFFICIAL(0xFC, TOP, ABX, 4, "NOP");
 
     // —— XAA / ANE family
-    SET_INS(0x8B, XAA, IMM, 2);
-    SET_INS(0x9B, XAS, ABY, 5);
+    SET_UNOFFICIAL(0x8B, XAA, IMM, 2, "XAA");
+    SET_UNOFFICIAL(0x9B, XAS, ABY, 5, "XAS");
 
-    SET_INS(0xFA, SKB, ABY, 4);
+    SET_UNOFFICIAL(0xFA, SKB, ABY, 4, "NOP");
 
     // —— ANC (ALR) “AND then set carry from bit 7”
-    SET_INS(0x0B, ANC, IMM, 2);
-    SET_INS(0x2B, ANC, IMM, 2);
+    SET_UNOFFICIAL(0x0B, ANC, IMM, 2, "ANC");
+    SET_UNOFFICIAL(0x2B, ANC, IMM, 2, "ANC");
 
     // —— SAX “store A & X”
-    SET_INS(0x87, SAX, ZP, 3);
-    SET_INS(0x97, SAX, ZPY, 4);
-    SET_INS(0x8F, SAX, ABS, 4);
-    SET_INS(0x83, SAX, IZX, 6);
-    SET_INS(0x93, SAX, IZY, 6);
+    SET_UNOFFICIAL(0x87, SAX, ZP, 3, "SAX");
+    SET_UNOFFICIAL(0x97, SAX, ZPY, 4, "SAX");
+    SET_UNOFFICIAL(0x8F, SAX, ABS, 4, "SAX");
+    SET_UNOFFICIAL(0x83, SAX, IZX, 6, "SAX");
+    SET_UNOFFICIAL(0x93, SAX, IZY, 6, "SAX");
 
     // —— single‐byte NOPs
-    SET_INS(0x1A, NOP, IMP, 2);
-    SET_INS(0x3A, NOP, IMP, 2);
-    SET_INS(0x5A, NOP, IMP, 2);
-    SET_INS(0x7A, NOP, IMP, 2);
-    SET_INS(0xDA, NOP, IMP, 2);
+    SET_UNOFFICIAL(0x1A, NOP, IMP, 2, "NOP");
+    SET_UNOFFICIAL(0x3A, NOP, IMP, 2, "NOP");
+    SET_UNOFFICIAL(0x5A, NOP, IMP, 2, "NOP");
+    SET_UNOFFICIAL(0x7A, NOP, IMP, 2, "NOP");
+    SET_UNOFFICIAL(0xDA, NOP, IMP, 2, "NOP");
 }
 
 // Addressing modes (return true if page crossed for ABX/ABY)
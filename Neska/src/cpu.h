@@ -5,6 +5,8 @@
 #include <iostream>
 #include "memory.h"
 #include "ppu.h"
+#include "savestate.h"
+#include "scheduler.h"
 
 // 6502 status flags
 static constexpr uint8_t FLAG_CARRY = 1 << 0;
@@ -16,6 +18,11 @@ static constexpr uint8_t FLAG_UNUSED = 1 << 5;
 static constexpr uint8_t FLAG_OVERFLOW = 1 << 6;
 static constexpr uint8_t FLAG_NEGATIVE = 1 << 7;
 
+// Level-triggered IRQ sources; the CPU's /IRQ line is the OR of all of them.
+static constexpr uint8_t IRQ_MAPPER = 1 << 0;
+static constexpr uint8_t IRQ_APU_FRAME = 1 << 1;
+static constexpr uint8_t IRQ_DMC = 1 << 2;
+
 // All 6502 addressing modes
 enum class AddrMode {
     IMP, ACC, IMM, ZP, ZPX, ZPY,
@@ -24,6 +31,7 @@ enum class AddrMode {
 
 // Forward declare CPU
 class CPU;
+class CpuTraceRecorder;
 
 // Instruction descriptor
 struct Instruction {
@@ -32,12 +40,35 @@ struct Instruction {
     uint8_t         cycles;      // base cycle count
     uint8_t(CPU::* operate)();   // core logic (returns extra cycles)
     uint16_t(CPU::* addrmode)();  // address fetch helper
+    bool            unofficial;  // undocumented opcode (nestest marks these with '*')
 };
 
 // Forward‑declare the 256-entry table
 extern Instruction instructionTable[256];
 
-class CPU {
+// Registers and in-flight instruction state: one cache line, and the
+// whole snapshot of the CPU. Plain data so it saves as a single copy.
+struct alignas(64) CpuState {
+    // Cycles executed since construction; the trace timestamp. Snapshots
+    // keep only its parity (the get/put phase OAM DMA aligns to); loading
+    // advances it by one if needed, so it stays monotonic.
+    uint64_t totalCycles;
+
+    int      cyclesRemaining;
+    int      stallCycles;  // DMA cycles still to run
+
+    // Registers
+    uint16_t PC;
+    uint16_t addr;     // computed address
+    uint8_t  A, X, Y, SP, status;
+    uint8_t  opcode;
+    uint8_t  fetched;  // operand fetched
+
+    bool     nmiRequested;
+    uint8_t  irqLines;  // IRQ_* sources currently asserted
+};
+
+class CPU : public CpuState {
 public:
     CPU(Memory& mem, PPU& ppu);
 
@@ -45,27 +76,50 @@ public:
 
     void requestNmi();
 
+    // Assert or release one IRQ source (IRQ_*).
+    void setIrq(uint8_t source, bool asserted) {
+        if (asserted) irqLines |= source;
+        else          irqLines &= uint8_t(~source);
+    }
+
+    // Power-on: clear registers, pending interrupts and DMA, move
+    // totalCycles on to the even phase a new CPU starts in, then reset().
+    void powerOn();
     void reset();
     void nmi();
     void irq();
 
-    // Execute one instruction
-    int tickCycle();
+    // Run one CPU cycle; an instruction executes on its first cycle and
+    // the rest only burn time. DMA stalls are run by the Emulator.
+    void tickCycle();
 
-    // Registers
-    uint16_t PC;
-    uint8_t  A, X, Y, SP, status;
-    int      cyclesRemaining;
-    uint8_t  opcode;
-    uint16_t addr;     // computed address
-    uint8_t  fetched;  // operand fetched
+    // Hold the CPU off the bus for 'cycles' (OAM or DMC DMA). The stall
+    // starts once the current cycle ends.
+    void stall(int cycles) {
+        stallCycles += cycles;
+        if (scheduler) scheduler->schedule(EventType::DmaStall, totalCycles);
+    }
 
-    int stallCycles;
+    // A DMC sample fetch takes the bus for 4 cycles. During an OAM DMA
+    // (the only stall that can be running) it slots into the transfer
+    // and costs 2.
+    void dmcStall() { stall(stallCycles > 0 ? 2 : 4); }
 
-    bool nmiRequested = false;
+    void setScheduler(Scheduler* s) { scheduler = s; }
+
+    // Record every instruction into 'recorder' (nullptr to stop).
+    void setTraceRecorder(CpuTraceRecorder* recorder) { traceRecorder = recorder; }
+
+    // Snapshot support: the CpuState block.
+    void saveState(StateWriter& w) const;
+    void loadState(StateReader& r);
 private:
     Memory* memory;
     PPU* ppu;
+    CpuTraceRecorder* traceRecorder = nullptr;
+    Scheduler* scheduler = nullptr;
+
+    void traceInstruction();
 
     // Bus read/write (hook these up to memory/map)
     uint8_t readByte(uint16_t addr);
@@ -0,0 +1,192 @@
+// cputrace.cpp
+#include "cputrace.h"
+#include "cpu.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const uint16_t CPU_TRACE_VERSION = 1;
+
+// ===========================
+// CpuTraceRecorder
+// ===========================
+CpuTraceRecorder::CpuTraceRecorder(size_t blockRecords, size_t blockCount)
+    : blockRecords(blockRecords ? blockRecords : 1),
+    current(nullptr),
+    currentIndex(0),
+    used(0),
+    lastCycle(0),
+    recordedCount(0),
+    stopping(false)
+{
+    if (blockCount < 2) blockCount = 2;
+    blocks.resize(blockCount);
+    for (auto& b : blocks) b.resize(this->blockRecords);
+}
+
+CpuTraceRecorder::~CpuTraceRecorder() {
+    close();
+}
+
+bool CpuTraceRecorder::open(const std::string& path, uint64_t startCycle) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to create CPU trace: " << path << "\n";
+        return false;
+    }
+
+    CpuTraceHeader header;
+    std::memcpy(header.magic, "NKCT", 4);
+    header.version = CPU_TRACE_VERSION;
+    header.recordSize = uint16_t(sizeof(CpuTraceRecord));
+    header.baseCycle = startCycle;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    freeBlocks.clear();
+    fullBlocks.clear();
+    for (size_t i = 1; i < blocks.size(); ++i) freeBlocks.push_back(i);
+    currentIndex = 0;
+    current = blocks[0].data();
+    used = 0;
+    lastCycle = startCycle;
+    recordedCount = 0;
+    stopping = false;
+    writer = std::thread(&CpuTraceRecorder::writerLoop, this);
+    return true;
+}
+
+void CpuTraceRecorder::submitBlock() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    fullBlocks.emplace_back(currentIndex, used);
+    recordedCount += used;
+    queueChanged.notify_all();
+
+    // Only blocks if the disk is behind by every spare block
+    queueChanged.wait(lock, [this] { return !freeBlocks.empty(); });
+    currentIndex = freeBlocks.front();
+    freeBlocks.pop_front();
+    current = blocks[currentIndex].data();
+    used = 0;
+}
+
+void CpuTraceRecorder::close() {
+    if (!writer.joinable()) return;
+    if (used > 0) submitBlock();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    writer.join();
+    file.close();
+}
+
+void CpuTraceRecorder::writerLoop() {
+    for (;;) {
+        std::pair<size_t, size_t> block;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return stopping || !fullBlocks.empty(); });
+            if (fullBlocks.empty()) return;  // stopping and drained
+            block = fullBlocks.front();
+            fullBlocks.pop_front();
+        }
+
+        file.write(reinterpret_cast<const char*>(blocks[block.first].data()),
+            std::streamsize(block.second * sizeof(CpuTraceRecord)));
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            freeBlocks.push_back(block.first);
+        }
+        queueChanged.notify_all();
+    }
+}
+
+// ===========================
+// CpuTraceReader
+// ===========================
+bool CpuTraceReader::open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open CPU trace: " << path << "\n";
+        return false;
+    }
+    CpuTraceHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, "NKCT", 4) != 0 ||
+        header.version != CPU_TRACE_VERSION || header.recordSize != sizeof(CpuTraceRecord)) {
+        std::cerr << "Not a supported CPU trace: " << path << "\n";
+        return false;
+    }
+    cycle = header.baseCycle;
+    return true;
+}
+
+bool CpuTraceReader::next(CpuTraceRecord& r, uint64_t& outCycle) {
+    if (!file.read(reinterpret_cast<char*>(&r), sizeof(r))) return false;
+    cycle += r.cycleDelta;
+    outCycle = cycle;
+    return true;
+}
+
+// ===========================
+// nestest formatting
+// ===========================
+int instructionLength(uint8_t opcode) {
+    switch (instructionTable[opcode].mode) {
+    case AddrMode::IMP:
+    case AddrMode::ACC:
+        return 1;
+    case AddrMode::ABS:
+    case AddrMode::ABX:
+    case AddrMode::ABY:
+    case AddrMode::IND:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+size_t formatNestestLine(const CpuTraceRecord& r, uint64_t cycle, char* out, size_t size) {
+    const Instruction& ins = instructionTable[r.bytes[0]];
+    int length = instructionLength(r.bytes[0]);
+    uint8_t  lo = r.bytes[1];
+    uint16_t abs = uint16_t(r.bytes[1] | (r.bytes[2] << 8));
+
+    char bytes[12];
+    if (length == 1)      std::snprintf(bytes, sizeof(bytes), "%02X", r.bytes[0]);
+    else if (length == 2) std::snprintf(bytes, sizeof(bytes), "%02X %02X", r.bytes[0], lo);
+    else std::snprintf(bytes, sizeof(bytes), "%02X %02X %02X", r.bytes[0], lo, r.bytes[2]);
+
+    char operand[16] = "";
+    switch (ins.mode) {
+    case AddrMode::IMP: break;
+    case AddrMode::ACC: std::snprintf(operand, sizeof(operand), "A"); break;
+    case AddrMode::IMM: std::snprintf(operand, sizeof(operand), "#$%02X", lo); break;
+    case AddrMode::ZP:  std::snprintf(operand, sizeof(operand), "$%02X", lo); break;
+    case AddrMode::ZPX: std::snprintf(operand, sizeof(operand), "$%02X,X", lo); break;
+    case AddrMode::ZPY: std::snprintf(operand, sizeof(operand), "$%02X,Y", lo); break;
+    case AddrMode::REL:
+        std::snprintf(operand, sizeof(operand), "$%04X", uint16_t(r.pc + 2 + int8_t(lo)));
+        break;
+    case AddrMode::ABS: std::snprintf(operand, sizeof(operand), "$%04X", abs); break;
+    case AddrMode::ABX: std::snprintf(operand, sizeof(operand), "$%04X,X", abs); break;
+    case AddrMode::ABY: std::snprintf(operand, sizeof(operand), "$%04X,Y", abs); break;
+    case AddrMode::IND: std::snprintf(operand, sizeof(operand), "($%04X)", abs); break;
+    case AddrMode::IZX: std::snprintf(operand, sizeof(operand), "($%02X,X)", lo); break;
+    case AddrMode::IZY: std::snprintf(operand, sizeof(operand), "($%02X),Y", lo); break;
+    }
+
+    char disasm[40];
+    std::snprintf(disasm, sizeof(disasm), "%s %s", ins.name, operand);
+
+    int n = std::snprintf(out, size,
+        "%04X  %-8s %c%-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3u,%3u CYC:%llu\n",
+        r.pc, bytes, ins.unofficial ? '*' : ' ', disasm,
+        r.a, r.x, r.y, r.p, r.sp, unsigned(r.scanline), unsigned(r.dot),
+        (unsigned long long)cycle);
+    if (n < 0) return 0;
+    return size_t(n) < size ? size_t(n) : size - 1;
+}
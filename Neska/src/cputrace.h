@@ -0,0 +1,104 @@
+// cputrace.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One executed instruction, captured before it runs. The cycle counter is
+// stored as a delta from the previous record to keep records at 16 bytes.
+struct CpuTraceRecord {
+    uint16_t pc;
+    uint8_t  bytes[3];     // opcode and up to two operand bytes
+    uint8_t  a, x, y, p, sp;
+    uint16_t scanline;
+    uint16_t dot;
+    uint16_t cycleDelta;   // CPU cycles since the previous record
+};
+static_assert(sizeof(CpuTraceRecord) == 16, "CpuTraceRecord must stay 16 bytes");
+
+// File layout (NKCT): header, then records back to back until EOF.
+struct CpuTraceHeader {
+    char     magic[4];     // "NKCT"
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t baseCycle;    // cycle the first record's delta is relative to
+};
+
+// Streams instruction records to disk. record() is an inline store into
+// the current block; full blocks are handed to a writer thread and written
+// whole. The producer only waits if every block is queued for disk, so no
+// record is ever dropped.
+class CpuTraceRecorder {
+public:
+    explicit CpuTraceRecorder(size_t blockRecords = 1 << 16, size_t blockCount = 4);
+    ~CpuTraceRecorder();
+
+    CpuTraceRecorder(const CpuTraceRecorder&) = delete;
+    CpuTraceRecorder& operator=(const CpuTraceRecorder&) = delete;
+
+    bool open(const std::string& path, uint64_t startCycle);
+
+    // Emulation thread, once per instruction. 'cycle' is absolute.
+    void record(CpuTraceRecord r, uint64_t cycle) {
+        uint64_t delta = cycle - lastCycle;
+        r.cycleDelta = uint16_t(delta > 0xFFFF ? 0xFFFF : delta);
+        lastCycle = cycle;
+        current[used++] = r;
+        if (used == blockRecords) submitBlock();
+    }
+
+    // Write everything recorded so far and close the file.
+    void close();
+
+    bool     isOpen() const { return file.is_open(); }
+    uint64_t recorded() const { return recordedCount + used; }
+
+private:
+    void submitBlock();
+    void writerLoop();
+
+    const size_t blockRecords;
+    std::vector<std::vector<CpuTraceRecord>> blocks;
+    CpuTraceRecord* current;
+    size_t   currentIndex;
+    size_t   used;
+    uint64_t lastCycle;
+    uint64_t recordedCount;
+
+    // Block indices waiting for disk / ready for reuse, with their sizes
+    std::deque<std::pair<size_t, size_t>> fullBlocks;
+    std::deque<size_t> freeBlocks;
+    bool stopping;
+
+    std::ofstream           file;
+    std::mutex              queueMutex;
+    std::condition_variable queueChanged;
+    std::thread             writer;
+};
+
+// Sequential reader for NKCT files; reconstructs absolute cycles.
+class CpuTraceReader {
+public:
+    bool open(const std::string& path);
+    bool next(CpuTraceRecord& r, uint64_t& cycle);
+
+private:
+    std::ifstream file;
+    uint64_t      cycle = 0;
+};
+
+// Number of bytes (1-3) of the instruction starting with 'opcode'.
+int instructionLength(uint8_t opcode);
+
+// Render a record in the nestest.log column layout, e.g.
+//   C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+// Effective-address annotations ("= 00") are not reproduced, as memory
+// contents are not part of the record. Returns the length written.
+size_t formatNestestLine(const CpuTraceRecord& r, uint64_t cycle, char* out, size_t size);
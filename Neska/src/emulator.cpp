@@ -1,27 +1,168 @@
 ﻿#include "emulator.h"
 
-Emulator::Emulator(CPU& cpu, PPU& ppu)
-    : cpu_(cpu), ppu_(ppu), frameDone_(false)
+#include <algorithm>
+
+static const int DOTS_PER_LINE = 341;
+static const int LINES_PER_FRAME = 262;
+static const int FRAME_DOTS = DOTS_PER_LINE * LINES_PER_FRAME;
+static const int PRE_RENDER_LINE = 261;
+
+Emulator::Emulator(CPU& cpu, PPU& ppu, APU& apu, Memory& memory)
+    : cpu_(cpu), ppu_(ppu), apu_(apu), memory_(memory),
+    counterLine_(0), counterDot_(0), frameDone_(false)
 {
+    cpu_.setScheduler(&scheduler_);
+    apu_.setScheduler(&scheduler_);
+    resync();
+}
+
+void Emulator::resync() {
+    scheduler_.clear();
+    if (cpu_.stallCycles > 0) scheduler_.schedule(EventType::DmaStall, cpu_.totalCycles);
+
+    // An NMI raised but not yet delivered is due now; otherwise the next
+    // vblank is scheduled once this frame ends, if it has already passed
+    int pos = ppu_.getScanline() * DOTS_PER_LINE + ppu_.getCycle();
+    if (ppu_.isNmiTriggered()) {
+        scheduler_.schedule(EventType::VBlank, cpu_.totalCycles);
+    }
+    else if (pos <= 241 * DOTS_PER_LINE + 1) {
+        scheduleDot(EventType::VBlank, 241, 1);
+    }
+    scheduleDot(EventType::FrameEnd, PRE_RENDER_LINE, DOTS_PER_LINE - 1);
+    scheduleScanlineCounter();
+    scheduler_.schedule(EventType::Apu, apu_.nextCpuEvent());
 }
 
 void Emulator::step() {
-    // 1) Execute exactly one CPU clock (including any DMA stalls)
-    int cpuClocks = cpu_.tickCycle();
-
-    // 2) For each CPU clock, run 3 PPU dots
-    for (int i = 0; i < cpuClocks * 3; ++i) {
-        ppu_.stepDot();
-        // As soon as the PPU raises NMI (and PPUCTRL bit 7 was set),
-        // queue it into the CPU
+    runSlice(cpu_.totalCycles + 1);
+}
+
+void Emulator::runFrame() {
+    frameDone_ = false;
+    while (!frameDone_) {
+        runSlice(Scheduler::NEVER);
+    }
+    frameDone_ = false;
+}
+
+void Emulator::runSlice(uint64_t limit) {
+    dispatchDue();
+
+    if (cpu_.stallCycles > 0) {
+        // DMA: the CPU is off the bus and only the PPU runs. A stall that
+        // outlasts the slice carries on in the next one.
+        uint64_t end = std::min({ limit, scheduler_.next(),
+            cpu_.totalCycles + uint64_t(cpu_.stallCycles) });
+        int cycles = int(end - cpu_.totalCycles);
+        cpu_.stallCycles -= cycles;
+        cpu_.totalCycles = end;
+        for (int i = 0; i < cycles * 3; ++i) {
+            ppu_.stepDot();
+        }
+    }
+    else {
+        // The CPU may move a deadline closer (a DMA, an APU register
+        // write), so the bound is re-read every cycle
+        while (cpu_.totalCycles < limit && cpu_.totalCycles < scheduler_.next()) {
+            cpu_.tickCycle();
+            ppu_.stepDot();
+            ppu_.stepDot();
+            ppu_.stepDot();
+        }
+    }
+
+    dispatchDue();
+}
+
+void Emulator::dispatchDue() {
+    EventType type;
+    while (scheduler_.pop(cpu_.totalCycles, type)) {
+        dispatch(type);
+    }
+}
+
+void Emulator::dispatch(EventType type) {
+    switch (type) {
+    case EventType::DmaStall:
+        // Only ends the slice; the next one runs the stall
+        break;
+
+    case EventType::VBlank:
+        // The PPU raised NMI (PPUCTRL bit 7 was set): queue it into the CPU
         if (ppu_.isNmiTriggered()) {
             cpu_.requestNmi();
             ppu_.clearNmiFlag();
         }
+        break;
+
+    case EventType::FrameEnd:
+        // Scheduled assuming the odd-frame dot skip; without it the wrap
+        // is still a dot away
+        if (ppu_.getScanline() == PRE_RENDER_LINE) {
+            scheduleDot(EventType::FrameEnd, PRE_RENDER_LINE, DOTS_PER_LINE - 1);
+            break;
+        }
+        frameDone_ = true;
+        apu_.endFrame(cpu_.totalCycles);
+        scheduleDot(EventType::VBlank, 241, 1);
+        scheduleDot(EventType::FrameEnd, PRE_RENDER_LINE, DOTS_PER_LINE - 1);
+        break;
+
+    case EventType::ScanlineCounter:
+        if (ppu_.getScanline() == counterLine_ && ppu_.getCycle() <= counterDot_) {
+            scheduleDot(EventType::ScanlineCounter, counterLine_, counterDot_);
+            break;
+        }
+        ppu_.clockScanlineCounter(counterDot_);
+        scheduleScanlineCounter();
+        break;
+
+    case EventType::Apu:
+        // Catching up raises the IRQ or fetches the DMC byte on time, and
+        // posts the next deadline
+        apu_.run(cpu_.totalCycles);
+        break;
+
+    case EventType::Count:
+        break;
     }
+}
+
+void Emulator::scheduleDot(EventType type, int line, int dot) {
+    int pos = ppu_.getScanline() * DOTS_PER_LINE + ppu_.getCycle();
+    int target = line * DOTS_PER_LINE + dot;
+    if (target < pos) target += FRAME_DOTS;
+
+    // Odd frames skip the pre-render line's first dot when rendering is
+    // on. Whether it is on by then is not known yet, so assume the skip:
+    // the event may fire a dot early and reschedule, but never late.
+    int dots = target - pos + 1;
+    int skipDot = PRE_RENDER_LINE * DOTS_PER_LINE;
+    if (ppu_.isOddFrame() && pos < skipDot && target > skipDot) dots--;
+
+    scheduler_.schedule(type, cpu_.totalCycles + uint64_t(dots + 2) / 3);
+}
 
-    // 3) Detect end‑of‑frame (PPU just wrapped to scanline=0, cycle=0)
-    frameDone_ = (ppu_.getScanline() == 0 && ppu_.getCycle() == 0);
+void Emulator::scheduleScanlineCounter() {
+    if (!memory_.usesScanlineCounter()) {
+        scheduler_.cancel(EventType::ScanlineCounter);
+        return;
+    }
+    // The next of the two candidate A12 dots that has not run yet
+    int line = ppu_.getScanline(), cycle = ppu_.getCycle();
+    if (cycle <= 260) {
+        counterDot_ = 260;
+    }
+    else if (cycle <= 324) {
+        counterDot_ = 324;
+    }
+    else {
+        counterDot_ = 260;
+        line = (line + 1) % LINES_PER_FRAME;
+    }
+    counterLine_ = line;
+    scheduleDot(EventType::ScanlineCounter, counterLine_, counterDot_);
 }
 
 bool Emulator::frameComplete() const {
@@ -34,4 +175,4 @@ void Emulator::resetFrameFlag() {
 
 const uint32_t* Emulator::getFrameBuffer() const {
     return ppu_.getFrameBuffer();
-}
\ No newline at end of file
+}
@@ -1,29 +1,62 @@
 #pragma once
 
+#include "apu.h"
 #include "cpu.h"
+#include "memory.h"
 #include "ppu.h"
+#include "scheduler.h"
 
-// Drives CPU and PPU in lockstep: 1 CPU clock = 3 PPU dots,
-// handles NMI wiring, DMA stalls, and frame completion.
+// Drives CPU and PPU in lockstep: 1 CPU clock = 3 PPU dots.
+//
+// Nothing is polled per dot or per cycle. Everything the run loop must
+// react to has a deadline in the scheduler: NMI at vblank, the frame
+// boundary, DMA stalls, mapper A12 clocks and the APU's next IRQ or
+// DMC fetch. The CPU and PPU run uninterrupted up to the earliest deadline,
+// the events due there are handled, and the loop goes on. Components
+// move their own deadlines (CPU::stall, the APU's next event); PPU events
+// are computed from the beam position.
 class Emulator {
 public:
-    Emulator(CPU& cpu, PPU& ppu);
+    Emulator(CPU& cpu, PPU& ppu, APU& apu, Memory& memory);
 
-    // Advance exactly one CPU clock (and its 3 PPU dots).
-    // Must be called repeatedly to run the emulation.
+    // Advance one CPU clock (and its 3 PPU dots), handling any events
+    // that come due.
     void step();
 
-    // Did we just finish a frame?  (i.e. PPU wrapped to scanline 0,cyle 0)
+    // Run until the PPU wraps to the next frame, then clear the flag.
+    void runFrame();
+
+    // Recompute every deadline from the components' current state. Call
+    // after a reset, inserting a cartridge or loading a snapshot.
+    void resync();
+
+    // Did we just finish a frame?  (i.e. PPU wrapped to scanline 0)
     bool frameComplete() const;
 
-    // Clear the just finished a frame flag so you can draw again.
+    // Clear the just finished a frame flag so you can draw again.
     void resetFrameFlag();
 
     // Grab the latest 256240 ARGB frame buffer from the PPU
     const uint32_t* getFrameBuffer() const;
 
 private:
-    CPU& cpu_;
-    PPU& ppu_;
+    // Run to 'limit' or the next deadline, whichever is first, handling
+    // the events due on either side.
+    void runSlice(uint64_t limit);
+    void dispatchDue();
+    void dispatch(EventType type);
+
+    // Schedule 'type' for the cycle in which the PPU runs dot 'dot' of
+    // line 'line' (this frame, or the next if already past).
+    void scheduleDot(EventType type, int line, int dot);
+    void scheduleScanlineCounter();
+
+    CPU&    cpu_;
+    PPU&    ppu_;
+    APU&    apu_;
+    Memory& memory_;
+    Scheduler scheduler_;
+    int  counterLine_;   // pending ScanlineCounter dot
+    int  counterDot_;
     bool frameDone_;
 };
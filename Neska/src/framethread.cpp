@@ -0,0 +1,48 @@
+// framethread.cpp
+#include "framethread.h"
+#include "machine.h"
+
+FrameThread::FrameThread(Machine& machine)
+    : machine(machine), requested(false), done(true), quit(false)
+{
+    worker = std::thread(&FrameThread::workerLoop, this);
+}
+
+FrameThread::~FrameThread() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void FrameThread::start() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        requested = true;
+        done = false;
+    }
+    wake.notify_one();
+}
+
+bool FrameThread::waitFor(std::chrono::microseconds timeout) {
+    std::unique_lock<std::mutex> guard(lock);
+    return finished.wait_for(guard, timeout, [this] { return done; });
+}
+
+void FrameThread::workerLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this] { return requested || quit; });
+        if (quit) return;
+        requested = false;
+
+        guard.unlock();
+        machine.runFrame();
+        guard.lock();
+
+        done = true;
+        finished.notify_one();
+    }
+}
@@ -0,0 +1,41 @@
+// framethread.h
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class Machine;
+
+// Runs Machine::runFrame() on a worker thread, one frame per start(), so
+// the calling thread stays free while the frame is emulated; the front
+// end uses that time to keep pumping window events into a LiveInput.
+// Between waitFor() returning true and the next start() the caller owns
+// the machine again.
+class FrameThread {
+public:
+    explicit FrameThread(Machine& machine);
+    ~FrameThread();
+
+    FrameThread(const FrameThread&) = delete;
+    FrameThread& operator=(const FrameThread&) = delete;
+
+    // Begin emulating the next frame.
+    void start();
+
+    // Wait up to 'timeout' for the frame; true once it is done.
+    bool waitFor(std::chrono::microseconds timeout);
+
+private:
+    void workerLoop();
+
+    Machine&                machine;
+    std::mutex              lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool                    requested;
+    bool                    done;
+    bool                    quit;
+    std::thread             worker;
+};
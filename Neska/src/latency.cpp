@@ -0,0 +1,187 @@
+// latency.cpp
+#include "latency.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include "checksum.h"
+#include "ppu.h"
+
+static double msBetween(LatencyTracker::Clock::time_point a, LatencyTracker::Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+LatencyTracker::LatencyTracker()
+    : reported(0), frames(0), lastHash(0), lastHashValid(false), lastLatched(0), lost(0)
+{
+    pending.reserve(MAX_PENDING);
+}
+
+void LatencyTracker::inputEvent(int button, bool pressed, Clock::time_point when) {
+    std::lock_guard<std::mutex> guard(lock);
+    // A tap shorter than the game's polling interval: the press is never
+    // latched and must not match a later press of the same button
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->stage == Stage::Input && it->button == button) {
+            lost++;
+            it = pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    if (pending.size() == MAX_PENDING) {
+        lost++;
+        return;
+    }
+    Pending p;
+    p.button = uint8_t(button);
+    p.pressed = pressed;
+    p.stage = Stage::Input;
+    p.frame = frames;
+    p.input = when;
+    pending.push_back(p);
+}
+
+void LatencyTracker::latched(uint8_t state) {
+    std::lock_guard<std::mutex> guard(lock);
+    // Games strobe every frame; only a change can latch anything new
+    if (state == lastLatched) return;
+    lastLatched = state;
+
+    auto now = Clock::now();
+    for (Pending& p : pending) {
+        if (p.stage != Stage::Input) continue;
+        if (((state >> p.button) & 1) != (p.pressed ? 1 : 0)) continue;
+        p.stage = Stage::Latched;
+        p.frame = frames;
+        p.latch = now;
+    }
+}
+
+void LatencyTracker::frameEmulated(const uint32_t* frameBuffer) {
+    std::lock_guard<std::mutex> guard(lock);
+    uint64_t frame = frames++;
+    if (pending.empty()) {
+        lastHashValid = false;
+        return;
+    }
+
+    auto now = Clock::now();
+    uint64_t hash = xxhash64(frameBuffer, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    bool changed = lastHashValid && hash != lastHash;
+    lastHash = hash;
+    lastHashValid = true;
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->stage == Stage::Latched && changed) {
+            it->stage = Stage::Visible;
+            it->frame = frame;
+            it->visible = now;
+        }
+        // Never latched (released first), or latched with nothing to show
+        bool stale = (it->stage == Stage::Input || it->stage == Stage::Latched) &&
+            frame - it->frame > TIMEOUT_FRAMES;
+        if (stale) {
+            lost++;
+            it = pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void LatencyTracker::presentBegin() {
+    std::lock_guard<std::mutex> guard(lock);
+    auto now = Clock::now();
+    for (Pending& p : pending) {
+        if (p.stage == Stage::Visible && p.frame + 1 == frames) {
+            p.stage = Stage::Presenting;
+            p.presentStart = now;
+        }
+    }
+}
+
+void LatencyTracker::presentEnd() {
+    std::lock_guard<std::mutex> guard(lock);
+    auto now = Clock::now();
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->stage == Stage::Presenting) {
+            finish(*it, now);
+            it = pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void LatencyTracker::finish(const Pending& p, Clock::time_point presented) {
+    LatencySample s;
+    s.button = p.button;
+    s.pressed = p.pressed;
+    s.latchMs = msBetween(p.input, p.latch);
+    s.emulateMs = msBetween(p.latch, p.visible);
+    s.renderMs = msBetween(p.visible, p.presentStart);
+    s.presentMs = msBetween(p.presentStart, presented);
+    samples.push_back(s);
+}
+
+bool LatencyTracker::takeSample(LatencySample& out) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (reported == samples.size()) return false;
+    out = samples[reported++];
+    return true;
+}
+
+void LatencyTracker::printSample(std::ostream& out, const LatencySample& s) {
+    static const char* names[8] = { "A", "B", "Select", "Start", "Up", "Down", "Left", "Right" };
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << "Latency: " << std::left << std::setw(6) << names[s.button & 7]
+        << (s.pressed ? " down" : " up  ") << std::right << std::fixed << std::setprecision(2)
+        << "  latch " << std::setw(6) << s.latchMs
+        << "  emulate " << std::setw(6) << s.emulateMs
+        << "  render " << std::setw(5) << s.renderMs
+        << "  present " << std::setw(6) << s.presentMs
+        << "  total " << std::setw(6) << s.totalMs() << " ms\n";
+    out.copyfmt(flags);
+}
+
+void LatencyTracker::printReport(std::ostream& out) const {
+    std::lock_guard<std::mutex> guard(lock);
+    if (samples.empty()) {
+        out << "Latency: no input reached the screen";
+        if (lost > 0) out << " (" << lost << " events unresolved)";
+        out << "\n";
+        return;
+    }
+
+    struct Column {
+        const char* name;
+        double (*get)(const LatencySample&);
+    };
+    static const Column columns[] = {
+        { "latch",   [](const LatencySample& s) { return s.latchMs; } },
+        { "emulate", [](const LatencySample& s) { return s.emulateMs; } },
+        { "render",  [](const LatencySample& s) { return s.renderMs; } },
+        { "present", [](const LatencySample& s) { return s.presentMs; } },
+        { "total",   [](const LatencySample& s) { return s.totalMs(); } }
+    };
+
+    std::ios flags(nullptr);
+    flags.copyfmt(out);
+    out << "Latency over " << samples.size() << " events (" << lost << " unresolved), ms:\n"
+        << "           p50     p90     p99     max\n" << std::fixed << std::setprecision(2);
+    std::vector<double> values(samples.size());
+    for (const Column& c : columns) {
+        std::transform(samples.begin(), samples.end(), values.begin(), c.get);
+        std::sort(values.begin(), values.end());
+        auto pct = [&](double q) { return values[size_t(q * double(values.size() - 1) + 0.5)]; };
+        out << "  " << std::left << std::setw(7) << c.name << std::right
+            << std::setw(8) << pct(0.50) << std::setw(8) << pct(0.90)
+            << std::setw(8) << pct(0.99) << std::setw(8) << values.back() << "\n";
+    }
+    out.copyfmt(flags);
+}
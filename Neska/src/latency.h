@@ -0,0 +1,91 @@
+// latency.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+// One key press or release followed from the keyboard to the screen.
+struct LatencySample {
+    uint8_t button;     // controller bit 0-7
+    bool    pressed;
+    double  latchMs;    // event -> the game strobes $4016 and latches it
+    double  emulateMs;  // latch -> end of the first frame that changed
+    double  renderMs;   // -> SDL_RenderPresent called (upscale, upload)
+    double  presentMs;  // -> SDL_RenderPresent returned
+
+    double totalMs() const { return latchMs + emulateMs + renderMs + presentMs; }
+};
+
+// Input-to-photon latency instrumentation for one machine.
+//
+// Each controller change is timestamped when the front end sees it, then
+// followed through four probes: the $4016 strobe that latches it
+// (Memory), the end of the first frame after the latch whose picture
+// differs from the one before (the main loop), and the call and return
+// of SDL_RenderPresent for that frame (Renderer). A change that the game
+// never latches, or that shows no visible effect within a second, is
+// dropped. Games that animate every frame resolve on the next frame, so
+// their numbers are a lower bound.
+//
+// Key events may arrive on another thread than the one emulating (see
+// LiveInput), so every call takes a lock; it is held briefly and taken a
+// few times a frame. Frames are only hashed while an event is in flight.
+class LatencyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LatencyTracker();
+
+    // Front end: controller bit 'button' changed at 'when'.
+    void inputEvent(int button, bool pressed, Clock::time_point when);
+
+    // Memory: the game latched 'state' into the shift register.
+    void latched(uint8_t state);
+
+    // Main loop: a frame finished emulating.
+    void frameEmulated(const uint32_t* frameBuffer);
+
+    // Renderer: around SDL_RenderPresent of the latest frame.
+    void presentBegin();
+    void presentEnd();
+
+    // Events completed since the last call, oldest first.
+    bool takeSample(LatencySample& out);
+
+    size_t completed() const { return samples.size(); }
+    uint64_t unresolved() const { return lost; }
+
+    // One line per event, and percentiles per stage over every event.
+    static void printSample(std::ostream& out, const LatencySample& s);
+    void printReport(std::ostream& out) const;
+
+private:
+    enum class Stage : uint8_t { Input, Latched, Visible, Presenting };
+
+    struct Pending {
+        uint8_t  button;
+        bool     pressed;
+        Stage    stage;
+        uint64_t frame;    // frame that latched it, then the frame showing it
+        Clock::time_point input, latch, visible, presentStart;
+    };
+
+    static const size_t MAX_PENDING = 16;
+    static const uint64_t TIMEOUT_FRAMES = 60;
+
+    mutable std::mutex         lock;
+    std::vector<Pending>       pending;
+    std::vector<LatencySample> samples;
+    size_t   reported;
+    uint64_t frames;        // frames emulated so far
+    uint64_t lastHash;      // of the previous frame, when hashed
+    bool     lastHashValid;
+    uint8_t  lastLatched;
+    uint64_t lost;
+
+    void finish(const Pending& p, Clock::time_point presented);
+};
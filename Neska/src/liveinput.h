@@ -0,0 +1,21 @@
+// liveinput.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// The controller byte (bit 0 = A ... bit 7 = Right) as the input thread
+// last saw it. Memory reads it at the moment a game strobes $4016 instead
+// of using the copy taken before the frame, so a key that goes down while
+// a frame is being emulated reaches the game in that frame when it polls
+// afterwards. Written by one thread, read by the emulation thread.
+class LiveInput {
+public:
+    void press(int bit)   { state_.fetch_or(uint8_t(1u << bit), std::memory_order_relaxed); }
+    void release(int bit) { state_.fetch_and(uint8_t(~(1u << bit)), std::memory_order_relaxed); }
+    void set(uint8_t state) { state_.store(state, std::memory_order_relaxed); }
+    uint8_t state() const { return state_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint8_t> state_{0};
+};
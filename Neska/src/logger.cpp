@@ -1,66 +1,142 @@
 ﻿#include "logger.h"
 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 
 Logger::Logger() :
 	consoleLoggingEnabled(false),
-	fileLoggingEnabled(false)
+	fileLoggingEnabled(false),
+	clock(nullptr),
+	logPath("log.txt"),
+	maxLogBytes(64ull << 20),
+	keepLogFiles(3),
+	logFileBytes(0),
+	running(false)
 {
-	std::memset(&writeBuffer, 0, sizeof(writeBuffer));
+}
+
+Logger::~Logger() {
+	stopWriter();
 }
 
 void Logger::toggleLogging(bool consoleLogging, bool fileLogging) {
+	// The writer reads these flags, so change them only while it is stopped
+	stopWriter();
 	consoleLoggingEnabled = consoleLogging;
 	fileLoggingEnabled = fileLogging;
+	if (consoleLoggingEnabled || fileLoggingEnabled) startWriter();
 }
 
-void Logger::logToConsole(const char* debugOutput) {
-    logBuffer.push({ std::string(debugOutput) });
+void Logger::setLogFile(const std::string& path, uint64_t maxBytes, unsigned keepFiles) {
+	bool wasRunning = running.load();
+	stopWriter();
+	logPath = path;
+	maxLogBytes = maxBytes;
+	keepLogFiles = keepFiles;
+	if (wasRunning) startWriter();
 }
 
-void Logger::logToFile(const char* debugOutput) {
-    logBuffer.push({ std::string(debugOutput) });
+void Logger::setClock(const uint64_t* cpuCycles) {
+	clock = cpuCycles;
 }
 
 void Logger::handleLogRequests() {
-    // if neither target is enabled, nothing to do
-    if (!consoleLoggingEnabled && !fileLoggingEnabled) return;
-
-    // open the file once if needed
-    std::ofstream fout;
-    if (fileLoggingEnabled) {
-        // pick a default file name or track it per-Log
-        fout.open("log.txt", std::ios::app);
-    }
-
-    size_t bufUsed = 0;
-    auto flush = [&]() {
-        if (bufUsed == 0) return;
-        if (consoleLoggingEnabled)
-            std::cout.write(writeBuffer.data(), bufUsed);
-        if (fileLoggingEnabled)
-            fout.write(writeBuffer.data(), bufUsed);
-        bufUsed = 0;
-        };
-
-    while (!logBuffer.empty()) {
-        Log entry = std::move(logBuffer.front());
-        const char* txt = entry.debugOutput.c_str();
-        size_t      len = std::strlen(txt);
-
-        // if it won’t fit, flush first
-        if (len > writeBuffer.size() - bufUsed) flush();
-
-        // copy into your 4 KiB buffer
-        std::memcpy(writeBuffer.data() + bufUsed, txt, len);
-        bufUsed += len;
-
-        // now *pop* it so it doesn’t sit in memory forever
-        logBuffer.pop();
-    }
-
-    // final flush of whatever’s left
-    flush();
-    if (fout.is_open()) fout.close();
+	if (running.load(std::memory_order_relaxed)) wake.notify_one();
+}
+
+void Logger::startWriter() {
+	if (!ring) {
+		ring = std::make_unique<TraceRing>();
+		writeBuffer.resize(64 * 1024);
+	}
+	if (fileLoggingEnabled) {
+		// Keep the file open for the writer's lifetime; appends like before
+		logFile.open(logPath, std::ios::binary | std::ios::app);
+		if (!logFile) {
+			std::cerr << "Failed to open log file: " << logPath << "\n";
+		}
+		logFile.seekp(0, std::ios::end);
+		std::streamoff pos = logFile.tellp();
+		logFileBytes = pos > 0 ? uint64_t(pos) : 0;
+	}
+	running.store(true);
+	writer = std::thread(&Logger::writerLoop, this);
+}
+
+void Logger::stopWriter() {
+	if (!writer.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		running.store(false);
+	}
+	wake.notify_one();
+	writer.join();
+	if (logFile.is_open()) logFile.close();
+}
+
+void Logger::writerLoop() {
+	TraceEvent events[256];
+	size_t used = 0;
+
+	for (;;) {
+		// Read the flag before draining so nothing recorded before a stop is lost
+		bool stopping = !running.load(std::memory_order_acquire);
+
+		size_t count;
+		while ((count = ring->pop(events, 256)) > 0) {
+			for (size_t i = 0; i < count; ++i) {
+				if (writeBuffer.size() - used < 128) {
+					writeBlock(writeBuffer.data(), used);
+					used = 0;
+				}
+				used += formatTraceEvent(events[i], writeBuffer.data() + used,
+					writeBuffer.size() - used);
+			}
+		}
+		if (used > 0) {
+			writeBlock(writeBuffer.data(), used);
+			used = 0;
+		}
+		if (stopping) break;
+
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait_for(lock, std::chrono::milliseconds(5), [this] {
+			return !running.load(std::memory_order_relaxed);
+		});
+	}
+
+	if (consoleLoggingEnabled) std::cout.flush();
+	if (logFile.is_open()) logFile.flush();
+}
+
+void Logger::writeBlock(const char* data, size_t size) {
+	if (consoleLoggingEnabled) {
+		std::cout.write(data, size);
+	}
+	if (fileLoggingEnabled && logFile.is_open()) {
+		if (maxLogBytes > 0 && logFileBytes + size > maxLogBytes && logFileBytes > 0) {
+			rotateLogFile();
+		}
+		logFile.write(data, size);
+		logFileBytes += size;
+	}
+}
+
+void Logger::rotateLogFile() {
+	logFile.close();
+
+	// log.txt -> log.txt.1 -> ... -> log.txt.N (oldest is removed)
+	if (keepLogFiles > 0) {
+		std::remove((logPath + "." + std::to_string(keepLogFiles)).c_str());
+		for (unsigned i = keepLogFiles; i > 1; --i) {
+			std::rename((logPath + "." + std::to_string(i - 1)).c_str(),
+				(logPath + "." + std::to_string(i)).c_str());
+		}
+		std::rename(logPath.c_str(), (logPath + ".1").c_str());
+	}
+
+	logFile.open(logPath, std::ios::binary | std::ios::trunc);
+	logFileBytes = 0;
 }
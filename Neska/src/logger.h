@@ -1,34 +1,80 @@
 #pragma once
 
-#include <queue>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
-
-struct Log {
-	std::string debugOutput;
-};
+#include <thread>
+#include <vector>
+#include "tracering.h"
 
 class Logger {
 public:
 	Logger();
+	~Logger();
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
 
+	// Enabling either target starts the writer thread; disabling both stops it
+	// after everything already recorded has been written.
 	void toggleLogging(bool consoleLogging, bool fileLogging);
 
-	// Logs debug output to the console.
-	void logToConsole(const char* debugOutput);
+	// File target for file logging (default "log.txt"). Once it grows past
+	// 'maxBytes' it is rotated to path.1 ... path.'keepFiles'.
+	void setLogFile(const std::string& path, uint64_t maxBytes = 64ull << 20, unsigned keepFiles = 3);
 
-	// Logs debug output to the desired file, creating said file should it not exist.
-	void logToFile(const char* debugOutput);
-	
-	// Merges all debug output into as few writes as possible, then handles all writes.
+	// Source of event timestamps (the CPU's cycle counter).
+	void setClock(const uint64_t* cpuCycles);
+
+	// Records one binary event. Categories outside NESKA_TRACE_MASK compile
+	// to nothing; enabled ones cost a few stores into the ring.
+	template <TraceCategory C>
+	void trace(uint8_t code, uint16_t arg0 = 0, uint32_t arg1 = 0) {
+		if constexpr (traceCategoryEnabled(C)) {
+			if (!consoleLoggingEnabled && !fileLoggingEnabled) return;
+			ring->push({ clock ? *clock : 0, uint8_t(C), code, arg0, arg1 });
+		}
+	}
+
+	// Nudges the writer thread, e.g. once per frame. Never waits on I/O.
 	void handleLogRequests();
+
+	// Events lost because the ring was full.
+	uint64_t droppedEvents() const { return ring ? ring->dropped() : 0; }
 private:
+	void startWriter();
+	void stopWriter();
+	void writerLoop();
+	void writeBlock(const char* data, size_t size);
+	void rotateLogFile();
+
 	bool consoleLoggingEnabled;
 	bool fileLoggingEnabled;
+	const uint64_t* clock;
+
+	// Events from 'trace', waiting to be formatted. Allocated when logging
+	// is first enabled, so machines that never log do not carry it.
+	std::unique_ptr<TraceRing> ring;
+
+	// Writer thread state. Everything below is only touched by the writer
+	// while it runs.
+	std::string   logPath;
+	uint64_t      maxLogBytes;
+	unsigned      keepLogFiles;
+	std::ofstream logFile;
+	uint64_t      logFileBytes;
 
-	// Primary buffer where logs are sent from 'logToConsole' and 'logToFile.'
-	std::queue<Log>logBuffer;
-	
-	// Debug output is merged into this buffer for writing.
-	std::array<char, 4096>writeBuffer;
-};
\ No newline at end of file
+	// Formatted output is merged into this block and written in one call
+	// (allocated with the ring).
+	std::vector<char> writeBuffer;
+
+	std::atomic<bool>       running;
+	std::mutex              wakeMutex;
+	std::condition_variable wake;
+	std::thread             writer;
+};
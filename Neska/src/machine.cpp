@@ -0,0 +1,233 @@
+// machine.cpp
+#include "machine.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Sections in the order they are written
+static const StateSection kSections[] = {
+    StateSection::Machine,
+    StateSection::CPU,
+    StateSection::PPU,
+    StateSection::Memory,
+    StateSection::Cartridge,
+    StateSection::APU
+};
+static const size_t kSectionCount = sizeof(kSections) / sizeof(kSections[0]);
+
+Machine::Machine()
+    : ppu_(MirrorMode::HORIZONTAL, logger_),
+    cpu_(memory_, ppu_),
+    emu_(cpu_, ppu_, apu_, memory_),
+    frames_(0),
+    batteryDirty_(0)
+{
+    memory_.setPPU(&ppu_);
+    memory_.setCPU(&cpu_);
+    memory_.setAPU(&apu_);
+    apu_.setCPU(&cpu_);
+    apu_.setMemory(&memory_);
+    ppu_.setMemory(&memory_);
+    logger_.setClock(&cpu_.totalCycles);
+}
+
+bool Machine::loadROM(const std::string& path) {
+    auto rom = loadRomImage(path);
+    if (!rom) return false;
+    loadROM(std::move(rom));
+    return true;
+}
+
+void Machine::loadROM(std::shared_ptr<const RomImage> rom) {
+    battery_.close();  // flushes the previous cartridge's save
+    batteryDirty_ = 0;
+    rom_ = std::move(rom);
+
+    // Load the ROM (header→PRG→CHR) and apply its mirroring mode
+    ppu_.setMirrorMode(memory_.loadROM(rom_));
+    emu_.resync();
+}
+
+bool Machine::attachBattery(const std::string& savPath) {
+    if (!rom_) return false;
+    const RomHeader& header = rom_->header;
+    if (!header.battery && header.prgNvramSize == 0) return false;
+
+    size_t size = 0;
+    if (!memory_.getPRGRAM(size) || !battery_.openWritable(savPath, size)) return false;
+    memory_.attachPRGRAM(battery_.writableData());
+    batteryDirty_ = 0;
+    lastBatteryFlush_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+void Machine::flushBattery(bool force, std::chrono::milliseconds interval) {
+    if (!battery_.writableData()) return;
+    batteryDirty_ |= memory_.takePRGRAMDirty();
+    if (batteryDirty_ == 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - lastBatteryFlush_ < interval) return;
+
+    // One range from the first to the last dirty 1 KB block
+    int first = 0, last = 7;
+    while (!(batteryDirty_ & (1u << first))) ++first;
+    while (!(batteryDirty_ & (1u << last))) --last;
+    battery_.flush(size_t(first) * 0x400, size_t(last - first + 1) * 0x400, force);
+    batteryDirty_ = 0;
+    lastBatteryFlush_ = now;
+}
+
+void Machine::powerOn(uint8_t ramFill) {
+    batteryDirty_ |= memory_.takePRGRAMDirty();  // still to be flushed
+    memory_.powerOn(rom_, ramFill);
+    if (rom_) {
+        ppu_.setMirrorMode(rom_->header.mirror);
+        // PRG-RAM starts out zeroed, unless a battery keeps it
+        if (battery_.writableData()) memory_.attachPRGRAM(battery_.writableData());
+    }
+    cpu_.powerOn();  // loads PC from $FFFC/$FFFD
+    ppu_.reset();    // clears all internal state
+    apu_.reset();
+    emu_.resync();
+    emu_.resetFrameFlag();
+    frames_ = 0;
+}
+
+size_t Machine::stateSize() const {
+    StateWriter measure(nullptr, 0);
+    writeState(measure);
+    return measure.size();
+}
+
+bool Machine::saveState(uint8_t* buffer, size_t size) const {
+    StateWriter w(buffer, size);
+    writeState(w);
+    return !w.overflowed();
+}
+
+bool Machine::loadState(const uint8_t* buffer, size_t size) {
+    StateReader r(buffer, size);
+    StateHeader header;
+    r.read(header);
+    if (r.failed() || header.magic != STATE_MAGIC || header.version != STATE_VERSION ||
+        header.romHash != memory_.getROMHash() || header.totalSize != size) {
+        return false;
+    }
+
+    // First pass: locate every known section and check its size against
+    // what this machine would write, so a bad snapshot changes nothing
+    size_t offsets[kSectionCount] = {};
+    bool found[kSectionCount] = {};
+    for (uint16_t i = 0; i < header.sectionCount; ++i) {
+        uint32_t tag = 0, length = 0;
+        r.read(tag);
+        r.read(length);
+        if (r.failed()) return false;
+
+        for (size_t s = 0; s < kSectionCount; ++s) {
+            if (tag != uint32_t(kSections[s])) continue;
+            StateWriter measure(nullptr, 0);
+            saveSection(measure, kSections[s]);
+            if (found[s] || length != measure.size()) return false;
+            found[s] = true;
+            offsets[s] = r.position();
+        }
+        r.skip(length);  // unknown sections are skipped
+        if (r.failed()) return false;
+    }
+    for (size_t s = 0; s < kSectionCount; ++s) {
+        if (!found[s]) return false;
+    }
+
+    // Second pass: restore
+    for (size_t s = 0; s < kSectionCount; ++s) {
+        StateReader section(buffer + offsets[s], size - offsets[s]);
+        loadSection(section, kSections[s]);
+    }
+    emu_.resync();
+    return true;
+}
+
+void Machine::writeState(StateWriter& w) const {
+    StateHeader header;
+    header.magic = STATE_MAGIC;
+    header.version = STATE_VERSION;
+    header.sectionCount = uint16_t(kSectionCount);
+    header.romHash = memory_.getROMHash();
+    header.totalSize = 0;
+
+    size_t headerAt = w.size();
+    w.write(header);
+    for (StateSection tag : kSections) {
+        writeSection(w, tag);
+    }
+    header.totalSize = uint32_t(w.size() - headerAt);
+    w.patch(headerAt, header);
+}
+
+void Machine::writeSection(StateWriter& w, StateSection tag) const {
+    w.write(uint32_t(tag));
+    size_t sizeAt = w.size();
+    w.write(uint32_t(0));
+    size_t start = w.size();
+    saveSection(w, tag);
+    w.patch(sizeAt, uint32_t(w.size() - start));
+}
+
+void Machine::saveSection(StateWriter& w, StateSection tag) const {
+    switch (tag) {
+    case StateSection::Machine:   w.write(frames_); break;
+    case StateSection::CPU:       cpu_.saveState(w); break;
+    case StateSection::PPU:       ppu_.saveState(w); break;
+    case StateSection::Memory:    memory_.saveState(w); break;
+    case StateSection::Cartridge: memory_.saveCartridgeState(w); break;
+    case StateSection::APU:       apu_.saveState(w); break;
+    }
+}
+
+void Machine::loadSection(StateReader& r, StateSection tag) {
+    switch (tag) {
+    case StateSection::Machine:   r.read(frames_); break;
+    case StateSection::CPU:       cpu_.loadState(r); break;
+    case StateSection::PPU:       ppu_.loadState(r); break;
+    case StateSection::Memory:    memory_.loadState(r); break;
+    case StateSection::Cartridge: memory_.loadCartridgeState(r); break;
+    case StateSection::APU:       apu_.loadState(r); break;
+    }
+}
+
+bool Machine::saveStateFile(const std::string& path) const {
+    std::vector<uint8_t> buffer(stateSize());
+    if (!saveState(buffer.data(), buffer.size())) return false;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to create save state: " << path << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    return bool(file);
+}
+
+bool Machine::loadStateFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open save state: " << path << "\n";
+        return false;
+    }
+    std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    if (!loadState(buffer.data(), buffer.size())) {
+        std::cerr << "Save state is corrupt, from another version, or for a different ROM: "
+            << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Machine::runFrame() {
+    emu_.runFrame();
+    frames_++;
+}
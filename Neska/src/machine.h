@@ -0,0 +1,102 @@
+// machine.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "apu.h"
+#include "logger.h"
+#include "mappedfile.h"
+#include "memory.h"
+#include "ppu.h"
+#include "cpu.h"
+#include "emulator.h"
+#include "rom.h"
+
+// One complete NES: owns every component and wires the back-pointers
+// between them. Machines share nothing mutable, so any number of them can
+// run on different threads. The only shared state is immutable: the CPU
+// instructionTable (filled before main) and RomImage data.
+class Machine {
+public:
+    Machine();
+
+    Machine(const Machine&) = delete;
+    Machine& operator=(const Machine&) = delete;
+
+    // Insert a cartridge. The image may be shared with other machines.
+    bool loadROM(const std::string& path);
+    void loadROM(std::shared_ptr<const RomImage> rom);
+
+    // Keep PRG-RAM in 'savPath' (created if missing) when the cartridge
+    // has a battery; returns false if it has none or the file cannot be
+    // mapped. Call after loadROM. Stores go straight into the mapping, so
+    // the CPU write path does no I/O and a crash loses nothing the OS has.
+    bool attachBattery(const std::string& savPath);
+
+    // Push battery RAM written since the last flush towards the disk.
+    // Cheap when nothing changed, so call it every frame; writes are
+    // coalesced to one flush per 'interval' unless 'force' is set.
+    void flushBattery(bool force = false,
+        std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+    // Power-on: fill RAM with 'ramFill', rebuild the cartridge (PRG-RAM
+    // is kept only when a battery backs it), release the controllers and
+    // reset CPU, PPU and APU.
+    void powerOn(uint8_t ramFill = 0);
+
+    // Emulate until the next frame boundary.
+    void runFrame();
+
+    // Snapshots of the complete machine (excluding the framebuffer) in the
+    // versioned container described in savestate.h. Saving writes straight
+    // into the caller's buffer with no allocation; loading validates the
+    // header, ROM hash and every section size before any state changes.
+    size_t stateSize() const;
+    bool   saveState(uint8_t* buffer, size_t size) const;
+    bool   loadState(const uint8_t* buffer, size_t size);
+
+    // Whole-file variants; errors are reported on stderr.
+    bool saveStateFile(const std::string& path) const;
+    bool loadStateFile(const std::string& path);
+
+    const uint32_t* getFrameBuffer() const { return ppu_.getFrameBuffer(); }
+    uint64_t frameCount() const { return frames_; }
+
+    Logger&   logger()   { return logger_; }
+    Memory&   memory()   { return memory_; }
+    PPU&      ppu()      { return ppu_; }
+    CPU&      cpu()      { return cpu_; }
+    APU&      apu()      { return apu_; }
+    Emulator& emulator() { return emu_; }
+
+    const std::shared_ptr<const RomImage>& rom() const { return rom_; }
+
+private:
+    void writeState(StateWriter& w) const;
+    void writeSection(StateWriter& w, StateSection tag) const;
+    void saveSection(StateWriter& w, StateSection tag) const;
+    void loadSection(StateReader& r, StateSection tag);
+
+    // Declaration order is construction order: PPU needs the logger,
+    // CPU needs memory and PPU, the emulator needs all of them. Memory,
+    // PPU and CPU each begin with their cache-line-aligned state block
+    // (MemoryState, PpuState, CpuState) and sit next to each other, so
+    // the hot state is a few contiguous runs and a snapshot of them is
+    // three block copies.
+    Logger   logger_;
+    Memory   memory_;
+    PPU      ppu_;
+    CPU      cpu_;
+    APU      apu_;
+    Emulator emu_;
+
+    std::shared_ptr<const RomImage> rom_;
+    uint64_t frames_;
+
+    // Battery-backed PRG-RAM (.sav) and the blocks not yet flushed
+    MappedFile battery_;
+    uint32_t   batteryDirty_;
+    std::chrono::steady_clock::time_point lastBatteryFlush_;
+};
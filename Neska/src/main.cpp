@@ -1,66 +1,503 @@
 ﻿// main.cpp
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <string>
+#include <chrono>
+#include <filesystem>
 
-#include "memory.h"
-#include "ppu.h"
-#include "cpu.h"
-#include "emulator.h"
+#include "machine.h"
+#include "runner.h"
 #include "renderer.h"
-#include "logger.h"
+#include "audio.h"
+#include "capture.h"
+#include "movie.h"
+#include "rewind.h"
+#include "cputrace.h"
+#include "romdb.h"
+#include "latency.h"
+#include "liveinput.h"
+#include "framethread.h"
+#include "netplay.h"
+#include "transport.h"
 
-int main() {
-    auto logger = std::make_unique<Logger>();
-    logger->toggleLogging(true, false);
+// Replay a movie headlessly at maximum speed. Returns the process exit code.
+static int playMovie(const Movie& movie, Machine& machine) {
+    Memory& memory = machine.memory();
+    uint32_t frames = movie.frameCount();
+    uint32_t mismatches = 0;
 
-    // 1) Construct core subsystems
-    auto memory = std::make_unique<Memory>();
-    auto ppu = std::make_unique<PPU>(MirrorMode::HORIZONTAL, *logger);
-    auto cpu = std::make_unique<CPU>(*memory, *ppu);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t f = 0; f < frames; ++f) {
+        for (int port = 0; port < movie.ports && port < 2; ++port) {
+            memory.setControllerState(movie.input(f, port), port);
+        }
+        machine.runFrame();
+        machine.logger().handleLogRequests();
+
+        if (movie.hasHashes) {
+            uint64_t h = frameHash(machine.getFrameBuffer(), memory.getRAM());
+            if (h != movie.hashes[f]) {
+                if (mismatches == 0) {
+                    std::cerr << "Replay diverged at frame " << f << "\n";
+                }
+                mismatches++;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Played " << frames << " frames in " << std::fixed << std::setprecision(3)
+        << seconds << " s (" << std::setprecision(1)
+        << (seconds > 0 ? frames / seconds : 0.0) << " fps)\n";
+    if (movie.hasHashes) {
+        std::cout << (mismatches ? "Replay NOT deterministic: " : "Replay verified, ")
+            << mismatches << " mismatching frames\n";
+    }
+    return mismatches ? 1 : 0;
+}
+
+// Run 'count' independent instances of one game across the thread pool.
+static int runBatch(const std::shared_ptr<const RomImage>& rom, const Movie& movie,
+    unsigned count, uint64_t frames, const RunnerConfig& config) {
+    // A movie, when given, is the input for every instance and caps the budget
+    if (movie.frameCount() > 0 && (frames == 0 || frames > movie.frameCount())) {
+        frames = movie.frameCount();
+    }
+    if (frames == 0) frames = 600;
+
+    std::vector<std::unique_ptr<Machine>> machines;
+    machines.reserve(count);
+    Runner runner(config);
+    for (unsigned i = 0; i < count; ++i) {
+        machines.push_back(std::make_unique<Machine>());
+        Machine& m = *machines.back();
+        m.loadROM(rom);
+        m.powerOn(movie.ramFill);
+        m.ppu().setPixelOutput(false);  // nobody looks at the pictures
+
+        Runner::FrameHook hook;
+        if (movie.frameCount() > 0) {
+            hook = [&movie](Machine& machine, uint64_t frame) {
+                for (int port = 0; port < movie.ports && port < 2; ++port) {
+                    machine.memory().setControllerState(movie.input(uint32_t(frame), port), port);
+                }
+            };
+        }
+        runner.add(m, frames, hook);
+    }
+
+    RunnerStats stats = runner.run();
+    std::cout << "Ran " << count << " instances x " << frames << " frames on "
+        << stats.framesPerWorker.size() << " workers: " << stats.frames << " frames in "
+        << std::fixed << std::setprecision(3) << stats.seconds << " s ("
+        << std::setprecision(1) << stats.framesPerSecond << " fps aggregate, "
+        << stats.steals << " steals)\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string romPath = "roms/donkey_kong.nes";
+    std::string capturePath;
+    VideoFormat captureFormat = VideoFormat::Y4M;
+    std::string recordPath;
+    std::string playPath;
+    bool movieHashes = false;
+    bool traceConsole = false;
+    std::string traceFile;
+    std::string cpuTracePath;
+    std::string catalogPath;
+    bool audioSync = false;
+    int audioLatencyMs = 20;
+    bool audioStats = false;
+    bool latencyStats = false;
+    bool liveInputMode = false;
+    unsigned frameSkip = 1;
+    uint16_t netplayPort = 7000;
+    std::string netplayPeer;
+    NetplayConfig netplayConfig;
+    unsigned instances = 0;
+    uint64_t batchFrames = 0;
+    RunnerConfig runnerConfig;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (arg == "--capture-format" && i + 1 < argc) {
+            std::string fmt = argv[++i];
+            if (fmt == "y4m")        captureFormat = VideoFormat::Y4M;
+            else if (fmt == "raw")   captureFormat = VideoFormat::Raw;
+            else if (fmt == "delta") captureFormat = VideoFormat::PaletteDelta;
+            else std::cerr << "Unknown capture format: " << fmt << "\n";
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--play" && i + 1 < argc) {
+            playPath = argv[++i];
+        }
+        else if (arg == "--movie-hashes") {
+            movieHashes = true;
+        }
+        else if (arg == "--trace") {
+            traceConsole = true;
+        }
+        else if (arg == "--trace-file" && i + 1 < argc) {
+            traceFile = argv[++i];
+        }
+        else if (arg == "--cpu-trace" && i + 1 < argc) {
+            cpuTracePath = argv[++i];
+        }
+        else if (arg == "--catalog" && i + 1 < argc) {
+            catalogPath = argv[++i];
+        }
+        else if (arg == "--audio-sync") {
+            audioSync = true;
+        }
+        else if (arg == "--audio-latency" && i + 1 < argc) {
+            audioLatencyMs = std::max(5, std::stoi(argv[++i]));
+        }
+        else if (arg == "--audio-stats") {
+            audioStats = true;
+        }
+        else if (arg == "--latency") {
+            latencyStats = true;
+        }
+        else if (arg == "--live-input") {
+            liveInputMode = true;
+        }
+        else if (arg == "--frame-skip" && i + 1 < argc) {
+            frameSkip = std::max(1u, unsigned(std::stoul(argv[++i])));
+        }
+        else if (arg == "--netplay-port" && i + 1 < argc) {
+            netplayPort = uint16_t(std::stoul(argv[++i]));
+        }
+        else if (arg == "--netplay-peer" && i + 1 < argc) {
+            netplayPeer = argv[++i];
+        }
+        else if (arg == "--player" && i + 1 < argc) {
+            netplayConfig.localPort = std::stoi(argv[++i]) == 2 ? 1 : 0;
+        }
+        else if (arg == "--input-delay" && i + 1 < argc) {
+            netplayConfig.inputDelay = uint32_t(std::stoul(argv[++i]));
+        }
+        else if (arg == "--rollback" && i + 1 < argc) {
+            netplayConfig.maxRollback = uint32_t(std::stoul(argv[++i]));
+        }
+        else if (arg == "--instances" && i + 1 < argc) {
+            instances = unsigned(std::stoul(argv[++i]));
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            batchFrames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            runnerConfig.workers = unsigned(std::stoul(argv[++i]));
+        }
+        else if (arg == "--pin") {
+            runnerConfig.pinWorkers = true;
+        }
+        else {
+            romPath = arg;
+        }
+    }
 
-    // 2) Wire them together
-    memory->setPPU(ppu.get());
-    memory->setCPU(cpu.get());
-    ppu->setMemory(memory.get());
+    // 1) Load the ROM once; every machine below shares the image. With a
+    //    catalog (see tools/neska_index) the ROM argument may also be part
+    //    of a file name, and known images get the catalog's header.
+    RomCatalog catalog;
+    bool haveCatalog = !catalogPath.empty() && catalog.open(catalogPath);
+    if (haveCatalog && !std::ifstream(romPath)) {
+        if (const CatalogEntry* e = catalog.findByName(romPath)) romPath = catalog.path(*e);
+    }
+    auto rom = loadRomImage(romPath, haveCatalog ? &catalog : nullptr);
+    if (!rom) return 1;
 
-    // 3) Load the ROM (header→PRG→CHR) and get its mirroring mode
-    std::vector<uint8_t> chrData;
-    MirrorMode mirror = memory->loadROM("roms/donkey_kong.nes", chrData);
-    ppu->setMirrorMode(mirror);
-    ppu->setCHR(chrData.data(), chrData.size());
+    Movie movie;
+    if (!playPath.empty()) {
+        if (!loadMovie(playPath, movie)) return 1;
+        if (movie.romHash != rom->hash) {
+            std::cerr << "Movie was recorded against a different ROM.\n";
+            return 1;
+        }
+    }
+    else {
+        movie.romHash = rom->hash;
+        movie.hasHashes = movieHashes;
+    }
 
-    // 4) Reset CPU & PPU to start executing the game's reset/vector code
-    cpu->reset();   // loads PC from $FFFC/$FFFD
-    ppu->reset();   // clears all internal state
+    // 2) Batch mode: many headless instances on the runner's thread pool
+    if (instances > 0) {
+        return runBatch(rom, movie, instances, batchFrames, runnerConfig);
+    }
 
-    Emulator emu(*cpu, *ppu);
+    // 3) Construct and wire one machine, insert the cartridge and power on
+    auto machine = std::make_unique<Machine>();
+    if (!traceFile.empty()) machine->logger().setLogFile(traceFile);
+    machine->logger().toggleLogging(traceConsole, !traceFile.empty());
+    machine->loadROM(rom);
+    machine->powerOn(movie.ramFill);
 
-    // 7) Create SDL window/renderer
+    // Battery saves live next to the ROM; movies and netplay always start
+    // from a blank cartridge so they run the same everywhere
+    bool netplay = !netplayPeer.empty();
+    if (netplay && !recordPath.empty()) {
+        std::cerr << "--record is ignored in netplay\n";
+        recordPath.clear();
+    }
+    if (playPath.empty() && recordPath.empty() && !netplay) {
+        std::string savPath = std::filesystem::path(romPath).replace_extension(".sav").string();
+        if (machine->attachBattery(savPath)) {
+            std::cout << "Battery save: " << savPath << "\n";
+        }
+    }
+
+    Memory& memory = machine->memory();
+    Emulator& emu = machine->emulator();
+    Logger& logger = machine->logger();
+
+    // Per-instruction CPU trace (binary; see tools/neska_trace)
+    CpuTraceRecorder cpuTrace;
+    if (!cpuTracePath.empty() && cpuTrace.open(cpuTracePath, machine->cpu().totalCycles)) {
+        machine->cpu().setTraceRecorder(&cpuTrace);
+    }
+
+    // 4) Movie playback runs headless, without SDL
+    if (!playPath.empty()) {
+        if (!movie.hasHashes) machine->ppu().setPixelOutput(false);
+        return playMovie(movie, *machine);
+    }
+
+    // 5) Create SDL window/renderer
     Renderer renderer(SCREEN_WIDTH * 4,
         SCREEN_HEIGHT * 4,
         "NES Emulator");
 
-    // 8) Main loop: step until a frame is done, then draw it
-    while (renderer.pollEvents(*memory)) {
-        while (!emu.frameComplete()) {
-            emu.step();
+    // Sound; without a playback device the game runs silently. The
+    // emulator is paced either by the sound card (--audio-sync) or by a
+    // frame-rate deadline, with the audio rate steered to match.
+    AudioOutput audio;
+    if (audio.open(48000, audioLatencyMs)) {
+        machine->apu().setSampleRate(audio.sampleRate());
+    }
+    audioSync = audioSync && audio.isOpen();
+    const auto framePeriod = std::chrono::nanoseconds(16639267);  // NTSC, 60.0988 Hz
+    auto nextFrame = std::chrono::steady_clock::now();
+    uint64_t shownFrames = 0;
+    uint64_t emulatedFrames = 0;
+    if (frameSkip > 1 && !recordPath.empty() && movieHashes) {
+        std::cerr << "--frame-skip is ignored while recording frame hashes\n";
+        frameSkip = 1;
+    }
+    if (frameSkip > 1 && !capturePath.empty()) {
+        std::cerr << "--frame-skip is ignored while capturing video\n";
+        frameSkip = 1;
+    }
+
+    // Video/screenshot capture runs on its own thread
+    FrameCapture capture;
+    if (!capturePath.empty()) {
+        capture.openVideo(capturePath, captureFormat);
+    }
+    int screenshotIndex = 0;
+    std::string quickStatePath = romPath + ".state";
+
+    // Rewind history; disabled while recording so the movie stays linear
+    // and in netplay, where both sides must run the same frames
+    RewindBuffer rewind;
+    bool rewindEnabled = recordPath.empty() && !netplay;
+
+    // Input-to-photon latency, one line per controller change
+    std::unique_ptr<LatencyTracker> latency;
+    if (latencyStats) {
+        latency = std::make_unique<LatencyTracker>();
+        memory.setLatencyTracker(latency.get());
+        renderer.setLatencyTracker(latency.get());
+    }
+
+    // Live input: frames run on a worker while this thread keeps pumping
+    // window events, and the game latches the keys as they are when it
+    // strobes. A movie needs the input fixed per frame, so not while
+    // recording.
+    LiveInput liveInput;
+    std::unique_ptr<FrameThread> frameThread;
+    if (liveInputMode && recordPath.empty() && !netplay) {
+        liveInput.set(memory.getControllerState());
+        memory.setLiveInput(&liveInput);
+        renderer.setLiveInput(&liveInput);
+        frameThread = std::make_unique<FrameThread>(*machine);
+    }
+    else if (liveInputMode) {
+        std::cerr << "--live-input is ignored while recording a movie or in netplay\n";
+    }
+    bool quit = false;
+
+    // Rollback netplay against a peer process: the keyboard plays this
+    // side's port, the session sets both ports every frame. Keys go to
+    // liveInput so the session's writes to Memory cannot clobber them.
+    UdpTransport transport;
+    std::unique_ptr<NetplaySession> session;
+    if (netplay) {
+        std::string host = netplayPeer;
+        uint16_t peerPort = netplayPort;
+        size_t colon = host.rfind(':');
+        if (colon != std::string::npos) {
+            peerPort = uint16_t(std::stoul(host.substr(colon + 1)));
+            host = host.substr(0, colon);
         }
+        if (!transport.open(netplayPort, host, peerPort)) return 1;
+        renderer.setLiveInput(&liveInput);
+        session = std::make_unique<NetplaySession>(*machine, transport, netplayConfig);
+        std::cout << "Netplay: player " << netplayConfig.localPort + 1 << " on UDP port "
+            << netplayPort << ", peer " << host << ":" << peerPort << "\n";
+    }
+
+    // 6) Main loop: step until a frame is done, then draw it
+    while (renderer.pollEvents(memory)) {
+        // Quick save/load happen on a frame boundary (not in netplay,
+        // where the peer would not follow). Loading is also off while
+        // recording: the movie must replay from power-on.
+        bool saveRequested = renderer.takeSaveStateRequest() && !session;
+        bool loadRequested = renderer.takeLoadStateRequest() && !session;
+        if (loadRequested && !recordPath.empty()) {
+            std::cerr << "Quick load is disabled while recording a movie\n";
+            loadRequested = false;
+        }
+        if (saveRequested && machine->saveStateFile(quickStatePath)) {
+            std::cout << "Saved state to " << quickStatePath << "\n";
+        }
+        if (loadRequested && machine->loadStateFile(quickStatePath)) {
+            std::cout << "Loaded state from " << quickStatePath << "\n";
+        }
+
+        // Input is latched once per frame so a recording replays exactly
+        uint8_t pad = session ? liveInput.state() : memory.getControllerState();
+
+        // Rewinding restores the previous frame's start state and re-runs
+        // it, so the window shows that frame; otherwise record the state
+        if (rewindEnabled && renderer.rewindHeld()) {
+            rewind.rewind(*machine);
+        }
+        else if (rewindEnabled) {
+            rewind.push(*machine);
+        }
+
+        // With --frame-skip only every Nth frame is drawn; the others run
+        // with the PPU's pixel output off and are not shown
+        bool drawFrame = emulatedFrames % frameSkip == 0;
+        machine->ppu().setPixelOutput(drawFrame);
+
+        if (session) {
+            // Waiting for the peer: nothing new to show yet
+            if (!session->advanceFrame(pad)) {
+                SDL_DelayNS(1000000);
+                continue;
+            }
+        }
+        else if (frameThread) {
+            frameThread->start();
+            while (!frameThread->waitFor(std::chrono::microseconds(500))) {
+                quit = !renderer.pollEvents(memory) || quit;
+            }
+            if (quit) break;
+        }
+        else {
+            machine->runFrame();
+        }
+        emulatedFrames++;
 
         // Grab the 256×240 ARGB buffer and upscale 4× for the window
         const uint32_t* rawFrame = emu.getFrameBuffer();
-        auto scaled = renderer.upscaleImage(rawFrame,
-            SCREEN_WIDTH,
-            SCREEN_HEIGHT,
-            4);
+        if (latency && drawFrame) latency->frameEmulated(rawFrame);
 
-        renderer.renderFrame(scaled.data());
+        if (!recordPath.empty()) {
+            movie.addFrame(&pad, movie.hasHashes ? frameHash(rawFrame, memory.getRAM()) : 0);
+        }
+
+        if (drawFrame) {
+            if (renderer.takeScreenshotRequest()) {
+                capture.requestScreenshot("screenshot_" + std::to_string(screenshotIndex++) + ".png");
+            }
+            capture.submitFrame(rawFrame);
+
+            auto scaled = renderer.upscaleImage(rawFrame,
+                SCREEN_WIDTH,
+                SCREEN_HEIGHT,
+                4);
+
+            renderer.renderFrame(scaled.data());
+        }
+        audio.submit(machine->apu(), audioSync);
         emu.resetFrameFlag();
+        machine->flushBattery();
         
-        logger->handleLogRequests();
+        logger.handleLogRequests();
+
+        LatencySample sample;
+        while (latency && latency->takeSample(sample)) {
+            LatencyTracker::printSample(std::cout, sample);
+        }
 
-        SDL_Delay(16);  // ~60 Hz
+        if (audioStats && ++shownFrames % 60 == 0) {
+            AudioStats a = audio.stats();
+            std::cout << "Audio: " << std::fixed << std::setprecision(1) << a.fillMs
+                << " ms queued, rate x" << std::setprecision(4) << a.ratio << ", "
+                << a.underruns << " underruns, " << a.dropped << " dropped\n";
+        }
+
+        // Audio pacing gives up after a few frames without the device
+        // pulling samples and the frame is paced by video instead
+        if (audioSync && audio.waitForAudio(framePeriod * 4)) {
+            nextFrame = std::chrono::steady_clock::now();
+        }
+        else {
+            // Sleep to the next frame deadline; after a long stall start
+            // afresh instead of racing to catch up
+            nextFrame += framePeriod;
+            auto now = std::chrono::steady_clock::now();
+            if (nextFrame > now) {
+                SDL_DelayNS(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(nextFrame - now).count()));
+            }
+            else if (now - nextFrame > framePeriod * 4) {
+                nextFrame = now;
+            }
+        }
+    }
+
+    if (!recordPath.empty()) {
+        saveMovie(recordPath, movie);
+    }
+    machine->flushBattery(true);
+
+    capture.close();
+    CaptureStats stats = capture.stats();
+    if (stats.dropped > 0) {
+        std::cerr << "Capture dropped " << stats.dropped << " of "
+            << stats.submitted << " frames\n";
+    }
+    AudioStats audioTotals = audio.stats();
+    if (audioTotals.underruns > 0 || audioTotals.dropped > 0) {
+        std::cerr << "Audio had " << audioTotals.underruns << " underruns, dropped "
+            << audioTotals.dropped << " samples\n";
+    }
+    if (session) {
+        const NetplayStats& n = session->stats();
+        std::cerr << "Netplay: " << n.frames << " frames, " << n.stalls << " stalls, "
+            << n.rollbacks << " rollbacks (" << n.resimulated << " frames re-run, deepest "
+            << n.maxDepth << ", slowest " << std::fixed << std::setprecision(2)
+            << n.maxRollbackMs << " ms), " << n.packetsSent << " packets sent, "
+            << n.packetsReceived << " received, " << n.packetsRejected << " rejected\n";
+    }
+    if (latency) {
+        memory.setLatencyTracker(nullptr);
+        renderer.setLatencyTracker(nullptr);
+        latency->printReport(std::cerr);
+    }
+    if (logger.droppedEvents() > 0) {
+        std::cerr << "Trace dropped " << logger.droppedEvents() << " events\n";
     }
 
     return 0;
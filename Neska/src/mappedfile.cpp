@@ -0,0 +1,190 @@
+// mappedfile.cpp
+#include "mappedfile.h"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Unable to open " << path << "\n";
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        std::cerr << "Empty or unreadable file: " << path << "\n";
+        CloseHandle(file);
+        return false;
+    }
+    // The mapping object keeps the file open; the file handle is not needed
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!map) {
+        std::cerr << "Unable to map " << path << "\n";
+        return false;
+    }
+    void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        std::cerr << "Unable to map " << path << "\n";
+        CloseHandle(map);
+        return false;
+    }
+    mapping = map;
+    base = static_cast<const uint8_t*>(view);
+    length = size_t(fileSize.QuadPart);
+    return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t minSize) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Unable to open " << path << " for writing\n";
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        std::cerr << "Unreadable file: " << path << "\n";
+        CloseHandle(file);
+        return false;
+    }
+    // A mapping larger than the file grows it, zero-filled
+    uint64_t mapSize = uint64_t(fileSize.QuadPart) < minSize ? minSize : uint64_t(fileSize.QuadPart);
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        DWORD(mapSize >> 32), DWORD(mapSize & 0xFFFFFFFF), nullptr);
+    if (!map) {
+        std::cerr << "Unable to map " << path << "\n";
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(map, FILE_MAP_WRITE, 0, 0, 0);
+    if (!view) {
+        std::cerr << "Unable to map " << path << "\n";
+        CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+    handle = file;
+    mapping = map;
+    base = static_cast<const uint8_t*>(view);
+    length = size_t(mapSize);
+    writable = true;
+    return true;
+}
+
+bool MappedFile::flush(size_t offset, size_t size, bool wait) {
+    if (!writable || offset >= length) return false;
+    if (size > length - offset) size = length - offset;
+    if (!FlushViewOfFile(base + offset, size)) return false;
+    return !wait || FlushFileBuffers(handle);
+}
+
+void MappedFile::close() {
+    if (writable) flush(0, length, true);
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    if (handle) CloseHandle(handle);
+    base = nullptr;
+    mapping = nullptr;
+    handle = nullptr;
+    length = 0;
+    writable = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Unable to open " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Empty or unreadable file: " << path << "\n";
+        ::close(fd);
+        return false;
+    }
+    // The mapping holds its own reference to the file
+    void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Unable to map " << path << "\n";
+        return false;
+    }
+    base = static_cast<const uint8_t*>(view);
+    length = size_t(st.st_size);
+    return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t minSize) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to open " << path << " for writing\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Unreadable file: " << path << "\n";
+        ::close(fd);
+        return false;
+    }
+    size_t mapSize = size_t(st.st_size);
+    if (mapSize < minSize) {
+        if (ftruncate(fd, off_t(minSize)) != 0) {  // zero-fills the new tail
+            std::cerr << "Unable to extend " << path << "\n";
+            ::close(fd);
+            return false;
+        }
+        mapSize = minSize;
+    }
+    void* view = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Unable to map " << path << "\n";
+        return false;
+    }
+    base = static_cast<const uint8_t*>(view);
+    length = mapSize;
+    writable = true;
+    return true;
+}
+
+bool MappedFile::flush(size_t offset, size_t size, bool wait) {
+    if (!writable || offset >= length) return false;
+    if (size > length - offset) size = length - offset;
+    // msync wants a page-aligned start
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % page;
+    return msync(const_cast<uint8_t*>(base) + start, size + (offset - start),
+        wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+void MappedFile::close() {
+    if (writable) flush(0, length, true);
+    if (base) munmap(const_cast<uint8_t*>(base), length);
+    base = nullptr;
+    length = 0;
+    writable = false;
+}
+
+#endif
@@ -0,0 +1,46 @@
+// mappedfile.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// A whole file mapped into memory. Pages are loaded on first touch and
+// live in the OS page cache, so every machine and every process mapping
+// the same file shares one physical copy. Writable mappings write through
+// that cache: a store is in the file as soon as it is made, and flush()
+// only controls when it reaches the disk.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map 'path' read-only. Prints why and returns false on failure.
+    bool open(const std::string& path);
+
+    // Map 'path' read-write, creating it or growing it (zero-filled) to
+    // at least 'minSize' bytes. Prints why and returns false on failure.
+    bool openWritable(const std::string& path, size_t minSize);
+
+    // Unmap; a writable mapping is flushed and waited for first.
+    void close();
+
+    const uint8_t* data() const { return base; }
+    uint8_t*       writableData() { return writable ? const_cast<uint8_t*>(base) : nullptr; }
+    size_t         size() const { return length; }
+
+    // Start write-back of the pages covering [offset, offset + length);
+    // with 'wait', return once they are on disk.
+    bool flush(size_t offset, size_t length, bool wait);
+
+private:
+    const uint8_t* base = nullptr;
+    size_t         length = 0;
+    bool           writable = false;
+#if defined(_WIN32)
+    void*          mapping = nullptr;  // HANDLE of the file mapping object
+    void*          handle = nullptr;   // file HANDLE, kept for writable maps
+#endif
+};
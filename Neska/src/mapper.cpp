@@ -3,107 +3,131 @@
 #include <algorithm>
 
 // Factory: choose appropriate mapper by ID
-std::unique_ptr<Mapper> createMapper(uint8_t mapperID) {
+Mapper createMapper(uint16_t mapperID) {
     switch (mapperID) {
-    case 0:  return std::make_unique<Mapper0>();
-    case 1:  return std::make_unique<Mapper1>();
-    case 2:  return std::make_unique<Mapper2>();
-    case 3:  return std::make_unique<Mapper3>();
+    case 0:  return Mapper0();
+    case 1:  return Mapper1();
+    case 2:  return Mapper2();
+    case 3:  return Mapper3();
+    case 4:  return Mapper4();
+    case 7:  return Mapper7();
+    case 9:  return Mapper9();
+    case 11: return Mapper11();
+    case 66: return Mapper66();
     default:
         std::cerr << "Mapper #" << int(mapperID)
             << " not implemented, falling back to NROM (Mapper0).\n";
-        return std::make_unique<Mapper0>();
+        return Mapper0();
     }
 }
 
 // ===========================
-// Mapper0: NROM
+// BankedMapper
 // ===========================
-void Mapper0::initMapper(uint8_t prgBanks,
-    uint8_t chrBanks,
-    const std::vector<uint8_t>& prgData,
-    const std::vector<uint8_t>& chrData) {
-    prgBanksCount = prgBanks;
-    chrBanksCount = chrBanks;
-    prgROM = prgData;
-    prgRAM.assign(0x2000, 0);
-    hasChrRam = (chrBanks == 0);
-    if (chrBanks == 0) {
-        chrROM.assign(0x2000, 0);
+void BankedMapper::initMapper(const std::shared_ptr<const RomImage>& image) {
+    rom = image;
+    prgROM = rom->prg.data;
+    prgSize = rom->prg.size;
+    prgRamBuffer.assign(PRG_RAM_SIZE, 0);
+    prgRAM = prgRamBuffer.data();
+    prgRamDirty = 0;
+    hasChrRam = rom->chr.empty();
+    if (hasChrRam) {
+        chrRAM.assign(std::max<size_t>(rom->header.chrRamSize + rom->header.chrNvramSize, 0x2000), 0);
+        chrROM = chrRAM.data();
+        chrSize = chrRAM.size();
     }
     else {
-        chrROM = chrData;
+        chrRAM.clear();
+        chrROM = rom->chr.data;
+        chrSize = rom->chr.size;
     }
+    mapPRG16(0, 0);
+    mapPRG16(1, -1);
+    mapCHR8(0);
 }
 
-uint8_t Mapper0::cpuRead(uint16_t addr) {
+void BankedMapper::cpuWrite(uint16_t addr, uint8_t data) {
     if (addr >= 0x6000 && addr < 0x8000) {
-        return prgRAM[addr - 0x6000];
+        writePrgRam(addr, data);
     }
-    uint32_t offset = addr - 0x8000;
-    if (prgBanksCount == 1) offset &= 0x3FFF;
-    return prgROM[offset];
 }
 
-void Mapper0::cpuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        prgRAM[addr - 0x6000] = data;
+// Resolve a bank number against a ROM of 'count' banks.
+static uint32_t wrapBank(int bank, size_t count) {
+    if (count == 0) return 0;
+    if (bank < 0) bank += int(count);
+    return bank < 0 ? 0 : uint32_t(size_t(bank) % count);
+}
+
+void BankedMapper::mapPRG8(int slot, int bank) {
+    prgOffset[slot & 3] = wrapBank(bank, prgSize / 0x2000) * 0x2000;
+}
+
+void BankedMapper::mapPRG16(int slot, int bank) {
+    uint32_t base = wrapBank(bank, prgSize / 0x4000) * 0x4000;
+    prgOffset[(slot & 1) * 2 + 0] = base;
+    prgOffset[(slot & 1) * 2 + 1] = base + 0x2000;
+}
+
+void BankedMapper::mapPRG32(int bank) {
+    // A 16 KB image appears twice, like NROM-128
+    size_t count = prgSize / 0x8000;
+    if (count == 0) {
+        mapPRG16(0, 0);
+        mapPRG16(1, 0);
+        return;
     }
+    uint32_t base = wrapBank(bank, count) * 0x8000;
+    for (int i = 0; i < 4; ++i) prgOffset[i] = base + i * 0x2000;
 }
 
-uint8_t Mapper0::ppuRead(uint16_t addr) {
-    uint8_t v = chrROM[addr & 0x1FFF];
-    return v;
+void BankedMapper::mapCHR1(int slot, int bank) {
+    chrOffset[slot & 7] = wrapBank(bank, chrSize / 0x0400) * 0x0400;
 }
 
-void Mapper0::ppuWrite(uint16_t addr, uint8_t data) {
-    if (!hasChrRam) return;
-    chrROM[addr & 0x1FFF] = data;
+void BankedMapper::mapCHR4(int slot, int bank) {
+    uint32_t base = wrapBank(bank, chrSize / 0x1000) * 0x1000;
+    for (int i = 0; i < 4; ++i) chrOffset[(slot & 1) * 4 + i] = base + i * 0x0400;
+}
+
+void BankedMapper::mapCHR8(int bank) {
+    uint32_t base = wrapBank(bank, chrSize / 0x2000) * 0x2000;
+    for (int i = 0; i < 8; ++i) chrOffset[i] = base + i * 0x0400;
+}
+
+void BankedMapper::saveState(StateWriter& w) const {
+    w.writeBytes(prgRAM, PRG_RAM_SIZE);
+    if (hasChrRam) w.writeBytes(chrRAM.data(), chrRAM.size());
+}
+
+void BankedMapper::loadState(StateReader& r) {
+    r.readBytes(prgRAM, PRG_RAM_SIZE);
+    prgRamDirty = 0xFF;
+    if (hasChrRam) r.readBytes(chrRAM.data(), chrRAM.size());
 }
 
 // ===========================
 // Mapper1: MMC1
 // ===========================
-void Mapper1::initMapper(uint8_t prgBanks,
-    uint8_t chrBanks,
-    const std::vector<uint8_t>& prgData,
-    const std::vector<uint8_t>& chrData) {
-    prgBanksCount = prgBanks;
-    chrBanksCount = chrBanks;
-    prgROM = prgData;
-    prgRAM.assign(0x2000, 0);
-    hasChrRam = (chrBanks == 0);
-    if (chrBanks == 0) {
-        chrROM.assign(0x2000, 0);
-    }
-    else {
-        chrROM = chrData;
-    }
+void Mapper1::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
     shiftReg = 0; shiftCount = 0;
-    control = 0x0C; prgMode = true; chrMode = false;
-    prgBank = prgBanks - 1; chrBank0 = chrBank1 = 0;
-}
-
-uint8_t Mapper1::cpuRead(uint16_t addr) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        return prgRAM[addr - 0x6000];
-    }
-    if (addr < 0x8000) {
-        return 0;  // open bus
-    }
-    return prgROM[getPRGAddress(addr)];
+    control = 0x0C;
+    prgBank = uint8_t(image->prg.size / 0x4000 - 1); chrBank0 = chrBank1 = 0;
+    updateBanks();
 }
 
 void Mapper1::cpuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        prgRAM[addr - 0x6000] = data;
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
         return;
     }
-    if (addr < 0x8000) return;
 
     if (data & 0x80) {
         shiftReg = 0; shiftCount = 0;
         control |= 0x0C;
+        updateBanks();
         return;
     }
     shiftReg |= (data & 1) << shiftCount;
@@ -111,155 +135,383 @@ void Mapper1::cpuWrite(uint16_t addr, uint8_t data) {
     if (shiftCount == 5) {
         uint8_t reg = (addr >> 13) & 0x03;
         switch (reg) {
-        case 0:
-            control = shiftReg & 0x1F;
-            chrMode = (control & 0x10) != 0;
-            prgMode = (control & 0x08) != 0;
-            break;
+        case 0: control = shiftReg & 0x1F; break;
         case 1: chrBank0 = shiftReg & 0x1F; break;
         case 2: chrBank1 = shiftReg & 0x1F; break;
         case 3: prgBank = shiftReg & 0x0F; break;
         }
         shiftReg = 0; shiftCount = 0;
+        updateBanks();
     }
 }
 
-uint8_t Mapper1::ppuRead(uint16_t addr) {
-    if (addr >= 0x2000) return 0;
-    return chrROM[getCHRAddress(addr)];
-}
-
-void Mapper1::ppuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x2000 || !hasChrRam) return;
-    chrROM[getCHRAddress(addr)] = data;
-}
-
-uint32_t Mapper1::getPRGAddress(uint16_t addr) const {
-    if (!prgMode) {
-        uint8_t bank = prgBank >> 1;
-        return bank * 0x8000 + (addr - 0x8000);
+void Mapper1::updateBanks() {
+    switch ((control >> 2) & 3) {
+    case 0:
+    case 1:  // 32 KB, low bit ignored
+        mapPRG32(prgBank >> 1);
+        break;
+    case 2:  // first bank fixed at $8000, switch $C000
+        mapPRG16(0, 0);
+        mapPRG16(1, prgBank);
+        break;
+    case 3:  // switch $8000, last bank fixed at $C000
+        mapPRG16(0, prgBank);
+        mapPRG16(1, -1);
+        break;
     }
-    if (addr < 0xC000) {
-        return prgBank * 0x4000 + (addr - 0x8000);
+    if (control & 0x10) {
+        mapCHR4(0, chrBank0);
+        mapCHR4(1, chrBank1);
     }
     else {
-        return (prgBanksCount - 1) * 0x4000 + (addr - 0xC000);
+        mapCHR8(chrBank0 >> 1);
     }
 }
 
-uint32_t Mapper1::getCHRAddress(uint16_t addr) const {
-    if (!chrMode) {
-        return (chrBank0 >> 1) * 0x2000 + (addr & 0x1FFF);
-    }
-    if (addr < 0x1000) {
-        return chrBank0 * 0x1000 + (addr & 0x0FFF);
-    }
-    else {
-        return chrBank1 * 0x1000 + (addr & 0x0FFF);
+bool Mapper1::mirroring(MirrorMode& mode) const {
+    switch (control & 3) {
+    case 0:  mode = MirrorMode::SINGLE_SCREEN; break;
+    case 1:  mode = MirrorMode::SINGLE_SCREEN_UPPER; break;
+    case 2:  mode = MirrorMode::VERTICAL; break;
+    default: mode = MirrorMode::HORIZONTAL; break;
     }
+    return true;
+}
+
+void Mapper1::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(shiftReg); w.write(shiftCount); w.write(control);
+    w.write(chrBank0); w.write(chrBank1); w.write(prgBank);
+}
+
+void Mapper1::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(shiftReg); r.read(shiftCount); r.read(control);
+    r.read(chrBank0); r.read(chrBank1); r.read(prgBank);
+    updateBanks();
 }
 
 // ===========================
 // Mapper2: UxROM
 // ===========================
-void Mapper2::initMapper(uint8_t prgBanks,
-    uint8_t chrBanks,
-    const std::vector<uint8_t>& prgData,
-    const std::vector<uint8_t>& chrData) {
-    prgBanksCount = prgBanks;
-    chrBanksCount = chrBanks;
-    prgROM = prgData;
-    prgRAM.assign(0x2000, 0);
-    hasChrRam = (chrBanks == 0);
-    if (chrBanks == 0) {
-        chrROM.assign(0x2000, 0);
+void Mapper2::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    bankSelect = 0;
+}
+
+void Mapper2::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
+        return;
     }
-    else {
-        chrROM = chrData;
+    bankSelect = data & 0x0F;
+    mapPRG16(0, bankSelect);
+}
+
+void Mapper2::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(bankSelect);
+}
+
+void Mapper2::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(bankSelect);
+    mapPRG16(0, bankSelect);
+}
+
+// ===========================
+// Mapper3: CNROM
+// ===========================
+void Mapper3::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    chrBankSelect = 0;
+}
+
+void Mapper3::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
+        return;
     }
+    chrBankSelect = data & 0x03;
+    mapCHR8(chrBankSelect);
+}
+
+void Mapper3::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(chrBankSelect);
+}
+
+void Mapper3::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(chrBankSelect);
+    mapCHR8(chrBankSelect);
+}
+
+// ===========================
+// Mapper4: MMC3
+// ===========================
+void Mapper4::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
     bankSelect = 0;
+    for (int i = 0; i < 8; ++i) bankRegs[i] = 0;
+    bankRegs[7] = 1;
+    mirrorReg = 0;
+    prgRamProtect = 0x80;
+    irqLatch = irqCounter = 0;
+    irqReload = irqEnabled = irqFlag = false;
+    fourScreen = image->header.mirror == MirrorMode::FOUR_SCREEN;
+    updateBanks();
 }
 
-uint8_t Mapper2::cpuRead(uint16_t addr) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        return prgRAM[addr - 0x6000];
+void Mapper4::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x6000) return;
+    if (addr < 0x8000) {
+        // Enabled and not write-protected
+        if ((prgRamProtect & 0xC0) == 0x80) writePrgRam(addr, data);
+        return;
     }
-    if (addr < 0x8000) return 0;
-    if (addr < 0xC000) {
-        return prgROM[bankSelect * 0x4000 + (addr - 0x8000)];
+
+    bool odd = addr & 1;
+    switch (addr & 0xE000) {
+    case 0x8000:
+        if (!odd) bankSelect = data;
+        else      bankRegs[bankSelect & 7] = data;
+        updateBanks();
+        break;
+    case 0xA000:
+        if (!odd) mirrorReg = data & 1;
+        else      prgRamProtect = data;
+        break;
+    case 0xC000:
+        if (!odd) irqLatch = data;
+        else      irqReload = true;   // counter reloads on the next clock
+        break;
+    case 0xE000:
+        if (!odd) {
+            irqEnabled = false;
+            irqFlag = false;          // disabling also acknowledges
+        }
+        else {
+            irqEnabled = true;
+        }
+        break;
+    }
+}
+
+void Mapper4::updateBanks() {
+    // PRG: R6/R7 switchable, second-last fixed; bit 6 swaps $8000 and $C000
+    if (bankSelect & 0x40) {
+        mapPRG8(0, -2);
+        mapPRG8(2, bankRegs[6]);
     }
     else {
-        return prgROM[(prgBanksCount - 1) * 0x4000 + (addr - 0xC000)];
+        mapPRG8(0, bankRegs[6]);
+        mapPRG8(2, -2);
+    }
+    mapPRG8(1, bankRegs[7]);
+    mapPRG8(3, -1);
+
+    // CHR: two 2 KB banks (R0, R1) and four 1 KB banks (R2-R5); bit 7
+    // swaps which half of the pattern space each group covers
+    int twoKB = (bankSelect & 0x80) ? 4 : 0;
+    int oneKB = (bankSelect & 0x80) ? 0 : 4;
+    mapCHR1(twoKB + 0, bankRegs[0] & 0xFE);
+    mapCHR1(twoKB + 1, bankRegs[0] | 0x01);
+    mapCHR1(twoKB + 2, bankRegs[1] & 0xFE);
+    mapCHR1(twoKB + 3, bankRegs[1] | 0x01);
+    for (int i = 0; i < 4; ++i) {
+        mapCHR1(oneKB + i, bankRegs[2 + i]);
     }
 }
 
-void Mapper2::cpuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        prgRAM[addr - 0x6000] = data;
-        return;
+bool Mapper4::mirroring(MirrorMode& mode) const {
+    if (fourScreen) return false;  // keep the header's FOUR_SCREEN
+    mode = mirrorReg ? MirrorMode::HORIZONTAL : MirrorMode::VERTICAL;
+    return true;
+}
+
+void Mapper4::clockScanline() {
+    if (irqCounter == 0 || irqReload) {
+        irqCounter = irqLatch;
+        irqReload = false;
+    }
+    else {
+        irqCounter--;
     }
-    if (addr >= 0x8000) {
-        bankSelect = data & 0x0F;
+    if (irqCounter == 0 && irqEnabled) {
+        irqFlag = true;
     }
 }
 
-uint8_t Mapper2::ppuRead(uint16_t addr) {
-    if (addr >= 0x2000) return 0;
-    return chrROM[addr & 0x1FFF];
+void Mapper4::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(bankSelect); w.writeBytes(bankRegs, sizeof(bankRegs));
+    w.write(mirrorReg); w.write(prgRamProtect);
+    w.write(irqLatch); w.write(irqCounter);
+    w.write(irqReload); w.write(irqEnabled); w.write(irqFlag);
 }
 
-void Mapper2::ppuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x2000 || !hasChrRam) return;
-    chrROM[addr & 0x1FFF] = data;
+void Mapper4::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(bankSelect); r.readBytes(bankRegs, sizeof(bankRegs));
+    r.read(mirrorReg); r.read(prgRamProtect);
+    r.read(irqLatch); r.read(irqCounter);
+    r.read(irqReload); r.read(irqEnabled); r.read(irqFlag);
+    updateBanks();
 }
 
 // ===========================
-// Mapper3: CNROM
+// Mapper7: AxROM
 // ===========================
-void Mapper3::initMapper(uint8_t prgBanks,
-    uint8_t chrBanks,
-    const std::vector<uint8_t>& prgData,
-    const std::vector<uint8_t>& chrData) {
-    prgBanksCount = prgBanks;
-    chrBanksCount = chrBanks;
-    prgROM = prgData;
-    prgRAM.assign(0x2000, 0);
-    hasChrRam = (chrBanks == 0);
-    if (chrBanks == 0) {
-        chrROM.assign(0x2000, 0);
-    }
-    else {
-        chrROM = chrData;
+void Mapper7::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    bankReg = 0;
+    mapPRG32(0);
+}
+
+void Mapper7::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
+        return;
     }
-    chrBankSelect = 0;
+    bankReg = data;
+    mapPRG32(bankReg & 0x07);
 }
 
-uint8_t Mapper3::cpuRead(uint16_t addr) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        return prgRAM[addr - 0x6000];
+bool Mapper7::mirroring(MirrorMode& mode) const {
+    mode = (bankReg & 0x10) ? MirrorMode::SINGLE_SCREEN_UPPER : MirrorMode::SINGLE_SCREEN;
+    return true;
+}
+
+void Mapper7::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(bankReg);
+}
+
+void Mapper7::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(bankReg);
+    mapPRG32(bankReg & 0x07);
+}
+
+// ===========================
+// Mapper9: MMC2
+// ===========================
+void Mapper9::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    prgBank = 0;
+    for (int i = 0; i < 4; ++i) chrRegs[i] = 0;
+    latchFE[0] = latchFE[1] = true;
+    mirrorReg = 0;
+    updateBanks();
+}
+
+void Mapper9::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
+        return;
     }
-    if (addr < 0x8000) return 0;
-    uint32_t off = addr - 0x8000;
-    if (prgBanksCount == 1) off &= 0x3FFF;
-    return prgROM[off];
+    switch (addr & 0xF000) {
+    case 0xA000: prgBank = data & 0x0F; break;
+    case 0xB000: chrRegs[0] = data & 0x1F; break;
+    case 0xC000: chrRegs[1] = data & 0x1F; break;
+    case 0xD000: chrRegs[2] = data & 0x1F; break;
+    case 0xE000: chrRegs[3] = data & 0x1F; break;
+    case 0xF000: mirrorReg = data & 1; break;
+    default: return;
+    }
+    updateBanks();
 }
 
-void Mapper3::cpuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x6000 && addr < 0x8000) {
-        prgRAM[addr - 0x6000] = data;
+void Mapper9::updateBanks() {
+    // One switchable 8 KB bank, then the last three fixed
+    mapPRG8(0, prgBank);
+    mapPRG8(1, -3);
+    mapPRG8(2, -2);
+    mapPRG8(3, -1);
+    mapCHR4(0, chrRegs[latchFE[0] ? 1 : 0]);
+    mapCHR4(1, chrRegs[latchFE[1] ? 3 : 2]);
+}
+
+bool Mapper9::mirroring(MirrorMode& mode) const {
+    mode = mirrorReg ? MirrorMode::HORIZONTAL : MirrorMode::VERTICAL;
+    return true;
+}
+
+void Mapper9::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(prgBank); w.writeBytes(chrRegs, sizeof(chrRegs));
+    w.write(latchFE[0]); w.write(latchFE[1]);
+    w.write(mirrorReg);
+}
+
+void Mapper9::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(prgBank); r.readBytes(chrRegs, sizeof(chrRegs));
+    r.read(latchFE[0]); r.read(latchFE[1]);
+    r.read(mirrorReg);
+    updateBanks();
+}
+
+// ===========================
+// Mapper11: Color Dreams
+// ===========================
+void Mapper11::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    bankReg = 0;
+    mapPRG32(0);
+}
+
+void Mapper11::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
         return;
     }
-    if (addr >= 0x8000) {
-        chrBankSelect = data & 0x03;
+    bankReg = data;
+    mapPRG32(bankReg & 0x03);
+    mapCHR8(bankReg >> 4);
+}
+
+void Mapper11::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(bankReg);
+}
+
+void Mapper11::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(bankReg);
+    mapPRG32(bankReg & 0x03);
+    mapCHR8(bankReg >> 4);
+}
+
+// ===========================
+// Mapper66: GxROM
+// ===========================
+void Mapper66::initMapper(const std::shared_ptr<const RomImage>& image) {
+    BankedMapper::initMapper(image);
+    bankReg = 0;
+    mapPRG32(0);
+}
+
+void Mapper66::cpuWrite(uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        BankedMapper::cpuWrite(addr, data);
+        return;
     }
+    bankReg = data;
+    mapPRG32((bankReg >> 4) & 0x03);
+    mapCHR8(bankReg & 0x03);
 }
 
-uint8_t Mapper3::ppuRead(uint16_t addr) {
-    if (addr >= 0x2000) return 0;
-    return chrROM[chrBankSelect * 0x2000 + (addr & 0x1FFF)];
+void Mapper66::saveState(StateWriter& w) const {
+    BankedMapper::saveState(w);
+    w.write(bankReg);
 }
 
-void Mapper3::ppuWrite(uint16_t addr, uint8_t data) {
-    if (addr >= 0x2000 || !hasChrRam) return;
-    chrROM[chrBankSelect * 0x2000 + (addr & 0x1FFF)] = data;
+void Mapper66::loadState(StateReader& r) {
+    BankedMapper::loadState(r);
+    r.read(bankReg);
+    mapPRG32((bankReg >> 4) & 0x03);
+    mapCHR8(bankReg & 0x03);
 }
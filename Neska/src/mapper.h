@@ -2,134 +2,390 @@
 
 #include <cstdint>
 #include <vector>
+#include <cstddef>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "core.h"
+#include "rom.h"
+#include "savestate.h"
 
-// Base class for all mappers: handles PRG & CHR banking
-class Mapper {
-public:
-    virtual ~Mapper() = default;
-
-    // Initialize with PRG-ROM banks, CHR-ROM/RAM banks, and their data
-    virtual void initMapper(uint8_t prgBanks,
-        uint8_t chrBanks,
-        const std::vector<uint8_t>& prgData,
-        const std::vector<uint8_t>& chrData) = 0;
+// Every mapper class provides the same non-virtual interface:
+//
+//   void     initMapper(shared_ptr<const RomImage>);
+//   uint8_t  cpuRead(addr);           // $6000-$FFFF
+//   const uint8_t* cpuPage(addr) const; // the 256-byte page at 'addr' in
+//                                     // place, or nullptr if reads have
+//                                     // side effects or are open bus
+//   void     cpuWrite(addr, data);
+//   uint8_t  ppuRead(addr);           // CHR $0000-$1FFF (const unless it
+//                                     // has side effects, as on MMC2)
+//   void     ppuWrite(addr, data);
+//   uint8_t* prgRamData(size_t& size);
+//   void     saveState(StateWriter&) const;
+//   void     loadState(StateReader&);
+//
+// plus three cartridge-to-console signals with defaults in MapperBase:
+//
+//   bool     mirroring(MirrorMode&) const;  // true if the mapper controls it
+//   void     clockScanline();               // PPU A12 rise, once per line
+//   bool     irqPending() const;            // level of the cartridge IRQ
+//
+// and 'hasScanlineCounter', true for boards that use clockScanline(), so
+// the emulator only schedules A12 events for them.
+//
+// Memory holds the cartridge as a 'Mapper' variant (below) and dispatches
+// through visitMapper(), so the read paths are resolved without virtual
+// calls and the small accessors defined in this header inline into the
+// bus code. Register writes are rarer and live in mapper.cpp.
 
-    // CPU-side access for addresses $6000–$FFFF
-    virtual uint8_t cpuRead(uint16_t addr) = 0;
-    virtual void    cpuWrite(uint16_t addr, uint8_t data) = 0;
+// Defaults for mappers without mirroring control or IRQs. Derived classes
+// hide these by declaring their own; nothing here is virtual.
+class MapperBase {
+public:
+    static constexpr bool hasScanlineCounter = false;
 
-    // PPU-side access for CHR $0000–$1FFF
-    virtual uint8_t ppuRead(uint16_t addr) = 0;
-    virtual void    ppuWrite(uint16_t addr, uint8_t data) = 0;
+    bool mirroring(MirrorMode&) const { return false; }
+    void clockScanline() {}
+    bool irqPending() const { return false; }
 };
 
-// Factory to create the appropriate mapper by ID
-std::unique_ptr<Mapper> createMapper(uint8_t mapperID);
-
 // ===========================
-// Mapper0: NROM (no bank switching)
+// BankedMapper: storage and bank windows shared by all boards
 // ===========================
-class Mapper0 : public Mapper {
+// The CPU sees $8000-$FFFF as four 8 KB windows and the PPU sees
+// $0000-$1FFF as eight 1 KB windows. Each window holds the byte offset of
+// its bank, so every read is one table lookup plus an add. Boards only
+// decode their registers and remap windows through the map* helpers;
+// the reads, CHR-RAM writes, PRG-RAM and snapshots come from here.
+//
+// PRG and CHR-ROM are read in place from the shared RomImage (usually a
+// file mapping); only PRG-RAM and CHR-RAM are private to the machine.
+class BankedMapper : public MapperBase {
 public:
-    void initMapper(uint8_t prgBanks,
-        uint8_t chrBanks,
-        const std::vector<uint8_t>& prgData,
-        const std::vector<uint8_t>& chrData) override;
-    uint8_t cpuRead(uint16_t addr) override;
-    void    cpuWrite(uint16_t addr, uint8_t data) override;
-    uint8_t ppuRead(uint16_t addr) override;
-    void    ppuWrite(uint16_t addr, uint8_t data) override;
+    BankedMapper() = default;
+    // chrROM and prgRAM may point into our buffers, so they move, not copy
+    BankedMapper(const BankedMapper&) = delete;
+    BankedMapper& operator=(const BankedMapper&) = delete;
+    BankedMapper(BankedMapper&&) = default;
+    BankedMapper& operator=(BankedMapper&&) = default;
 
-private:
-    std::vector<uint8_t> prgROM;
-    std::vector<uint8_t> prgRAM;   // 8 KB PRG-RAM at $6000–$7FFF
-    std::vector<uint8_t> chrROM;
-    uint8_t prgBanksCount = 0;
-    uint8_t chrBanksCount = 0;
+    // Maps the first 16 KB of PRG at $8000, the last 16 KB at $C000 and
+    // the first 8 KB of CHR (the NROM layout).
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    uint8_t cpuRead(uint16_t addr);
+    const uint8_t* cpuPage(uint16_t addr) const;
+    void    cpuWrite(uint16_t addr, uint8_t data);  // PRG-RAM only
+    uint8_t ppuRead(uint16_t addr) const;
+    void    ppuWrite(uint16_t addr, uint8_t data);
+    uint8_t* prgRamData(size_t& size) { size = PRG_RAM_SIZE; return prgRAM; }
+
+    // Use 'ram' (at least 8 KB, e.g. a mapped battery file) as PRG-RAM
+    // from now on; its current contents become the cartridge's.
+    void     attachPrgRam(uint8_t* ram) { prgRAM = ram; prgRamDirty = 0; }
+
+    // 1 KB blocks of PRG-RAM written since the last call (bit n = block n).
+    uint32_t takePrgRamDirty() { uint32_t d = prgRamDirty; prgRamDirty = 0; return d; }
+
+    // PRG-RAM and CHR-RAM. Boards append their registers and rebuild the
+    // windows from them on load.
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+protected:
+    static constexpr size_t PRG_RAM_SIZE = 0x2000;
+
+    void writePrgRam(uint16_t addr, uint8_t data) {
+        prgRAM[addr - 0x6000] = data;
+        prgRamDirty |= 1u << ((addr >> 10) & 7);
+    }
+
+    // Bank numbers wrap to the ROM size; negative numbers count from the
+    // last bank (-1 = last).
+    void mapPRG8(int slot, int bank);    // slot 0-3: $8000, $A000, $C000, $E000
+    void mapPRG16(int slot, int bank);   // slot 0-1: $8000, $C000
+    void mapPRG32(int bank);
+    void mapCHR1(int slot, int bank);    // slot 0-7
+    void mapCHR4(int slot, int bank);    // slot 0-1: $0000, $1000
+    void mapCHR8(int bank);
+
+    std::shared_ptr<const RomImage> rom;  // keeps prgROM/chrROM alive
+    const uint8_t* prgROM = nullptr;
+    size_t         prgSize = 0;
+    const uint8_t* chrROM = nullptr;      // CHR-ROM, or chrRAM.data()
+    size_t         chrSize = 0;
+    uint8_t*       prgRAM = nullptr;      // 8 KB at $6000-$7FFF: prgRamBuffer or attached
+    uint32_t       prgRamDirty = 0;
+    std::vector<uint8_t> prgRamBuffer;
+    std::vector<uint8_t> chrRAM;          // header size (8 KB min), only without CHR-ROM
     bool    hasChrRam = false;
+
+    uint32_t prgOffset[4] = {};
+    uint32_t chrOffset[8] = {};
+};
+
+// ===========================
+// Mapper0: NROM (no bank switching)
+// ===========================
+class Mapper0 : public BankedMapper {
 };
 
 // ===========================
 // Mapper1: MMC1
 // ===========================
-class Mapper1 : public Mapper {
+class Mapper1 : public BankedMapper {
 public:
-    void initMapper(uint8_t prgBanks,
-        uint8_t chrBanks,
-        const std::vector<uint8_t>& prgData,
-        const std::vector<uint8_t>& chrData) override;
-    uint8_t cpuRead(uint16_t addr) override;
-    void    cpuWrite(uint16_t addr, uint8_t data) override;
-    uint8_t ppuRead(uint16_t addr) override;
-    void    ppuWrite(uint16_t addr, uint8_t data) override;
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
 
-private:
-    std::vector<uint8_t> prgROM;
-    std::vector<uint8_t> prgRAM;
-    std::vector<uint8_t> chrROM;
-    uint8_t prgBanksCount = 0;
-    uint8_t chrBanksCount = 0;
-    bool    hasChrRam = false;
+    bool mirroring(MirrorMode& mode) const;
 
+private:
     // MMC1 registers
     uint8_t shiftReg = 0;
     int     shiftCount = 0;
-    uint8_t control = 0x0C;
+    uint8_t control = 0x0C;   // mirroring, PRG mode (bits 2-3), CHR mode (bit 4)
     uint8_t chrBank0 = 0;
     uint8_t chrBank1 = 0;
     uint8_t prgBank = 0;
-    bool    prgMode = false;
-    bool    chrMode = false;
 
-    uint32_t getPRGAddress(uint16_t addr) const;
-    uint32_t getCHRAddress(uint16_t addr) const;
+    void updateBanks();
 };
 
 // ===========================
 // Mapper2: UxROM
 // ===========================
-class Mapper2 : public Mapper {
+class Mapper2 : public BankedMapper {
 public:
-    void initMapper(uint8_t prgBanks,
-        uint8_t chrBanks,
-        const std::vector<uint8_t>& prgData,
-        const std::vector<uint8_t>& chrData) override;
-    uint8_t cpuRead(uint16_t addr) override;
-    void    cpuWrite(uint16_t addr, uint8_t data) override;
-    uint8_t ppuRead(uint16_t addr) override;
-    void    ppuWrite(uint16_t addr, uint8_t data) override;
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
 
 private:
-    std::vector<uint8_t> prgROM;
-    std::vector<uint8_t> prgRAM;
-    std::vector<uint8_t> chrROM;
-    uint8_t prgBanksCount = 0;
-    uint8_t chrBanksCount = 0;
-    bool    hasChrRam = false;
     uint8_t bankSelect = 0;  // 16KB PRG bank at $8000
 };
 
 // ===========================
 // Mapper3: CNROM
 // ===========================
-class Mapper3 : public Mapper {
+class Mapper3 : public BankedMapper {
 public:
-    void initMapper(uint8_t prgBanks,
-        uint8_t chrBanks,
-        const std::vector<uint8_t>& prgData,
-        const std::vector<uint8_t>& chrData) override;
-    uint8_t cpuRead(uint16_t addr) override;
-    void    cpuWrite(uint16_t addr, uint8_t data) override;
-    uint8_t ppuRead(uint16_t addr) override;
-    void    ppuWrite(uint16_t addr, uint8_t data) override;
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
 
 private:
-    std::vector<uint8_t> prgROM;
-    std::vector<uint8_t> prgRAM;
-    std::vector<uint8_t> chrROM;
-    uint8_t prgBanksCount = 0;
-    uint8_t chrBanksCount = 0;
-    bool    hasChrRam = false;
     uint8_t chrBankSelect = 0;  // 8KB CHR bank
-};
\ No newline at end of file
+};
+
+// ===========================
+// Mapper4: MMC3 (TxROM)
+// ===========================
+class Mapper4 : public BankedMapper {
+public:
+    static constexpr bool hasScanlineCounter = true;
+
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    uint8_t cpuRead(uint16_t addr);
+    const uint8_t* cpuPage(uint16_t addr) const;
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+    bool mirroring(MirrorMode& mode) const;
+    void clockScanline();
+    bool irqPending() const { return irqFlag; }
+
+private:
+    // Registers
+    uint8_t bankSelect = 0;      // $8000: target register, PRG/CHR modes
+    uint8_t bankRegs[8] = {};    // R0-R7
+    uint8_t mirrorReg = 0;       // $A000: 0 = vertical, 1 = horizontal
+    uint8_t prgRamProtect = 0x80;// $A001: bit 7 enable, bit 6 write-protect
+    uint8_t irqLatch = 0;        // $C000
+    uint8_t irqCounter = 0;
+    bool    irqReload = false;   // $C001
+    bool    irqEnabled = false;  // $E000/$E001
+    bool    irqFlag = false;
+    bool    fourScreen = false;  // header flag: the board has its own VRAM and ignores $A000
+
+    void updateBanks();
+};
+
+// ===========================
+// Mapper7: AxROM
+// ===========================
+class Mapper7 : public BankedMapper {
+public:
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+    bool mirroring(MirrorMode& mode) const;
+
+private:
+    uint8_t bankReg = 0;  // bits 0-2: 32KB PRG bank, bit 4: nametable page
+};
+
+// ===========================
+// Mapper9: MMC2 (PxROM)
+// ===========================
+class Mapper9 : public BankedMapper {
+public:
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    // Not const: fetching tile $FD or $FE flips that half's CHR latch.
+    uint8_t ppuRead(uint16_t addr);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+    bool mirroring(MirrorMode& mode) const;
+
+private:
+    uint8_t prgBank = 0;         // $A000: 8KB PRG bank at $8000
+    uint8_t chrRegs[4] = {};     // $B000-$E000: {$FD, $FE} banks for each 4KB half
+    bool    latchFE[2] = { true, true };
+    uint8_t mirrorReg = 0;       // $F000: 0 = vertical, 1 = horizontal
+
+    void updateBanks();
+};
+
+// ===========================
+// Mapper11: Color Dreams
+// ===========================
+class Mapper11 : public BankedMapper {
+public:
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+private:
+    uint8_t bankReg = 0;  // bits 0-1: 32KB PRG bank, bits 4-7: 8KB CHR bank
+};
+
+// ===========================
+// Mapper66: GxROM
+// ===========================
+class Mapper66 : public BankedMapper {
+public:
+    void initMapper(const std::shared_ptr<const RomImage>& rom);
+    void    cpuWrite(uint16_t addr, uint8_t data);
+    void    saveState(StateWriter& w) const;
+    void    loadState(StateReader& r);
+
+private:
+    uint8_t bankReg = 0;  // bits 4-5: 32KB PRG bank, bits 0-1: 8KB CHR bank
+};
+
+// ===========================
+// Hot-path accessors (inline)
+// ===========================
+inline uint8_t BankedMapper::cpuRead(uint16_t addr) {
+    if (addr >= 0x8000) {
+        return prgROM[prgOffset[(addr >> 13) & 3] + (addr & 0x1FFF)];
+    }
+    if (addr >= 0x6000) {
+        return prgRAM[addr - 0x6000];
+    }
+    return 0;  // open bus
+}
+
+inline const uint8_t* BankedMapper::cpuPage(uint16_t addr) const {
+    if (addr >= 0x8000) {
+        return prgROM ? prgROM + prgOffset[(addr >> 13) & 3] + (addr & 0x1F00) : nullptr;
+    }
+    if (addr >= 0x6000) {
+        return prgRAM ? prgRAM + (addr & 0x1F00) : nullptr;
+    }
+    return nullptr;
+}
+
+inline uint8_t BankedMapper::ppuRead(uint16_t addr) const {
+    return chrROM[chrOffset[(addr >> 10) & 7] + (addr & 0x03FF)];
+}
+
+inline void BankedMapper::ppuWrite(uint16_t addr, uint8_t data) {
+    if (!hasChrRam) return;
+    chrRAM[chrOffset[(addr >> 10) & 7] + (addr & 0x03FF)] = data;
+}
+
+inline uint8_t Mapper4::cpuRead(uint16_t addr) {
+    if (addr >= 0x8000) {
+        return prgROM[prgOffset[(addr >> 13) & 3] + (addr & 0x1FFF)];
+    }
+    if (addr >= 0x6000 && (prgRamProtect & 0x80)) {
+        return prgRAM[addr - 0x6000];
+    }
+    return 0;  // open bus
+}
+
+inline const uint8_t* Mapper4::cpuPage(uint16_t addr) const {
+    if (addr < 0x8000 && !(prgRamProtect & 0x80)) return nullptr;
+    return BankedMapper::cpuPage(addr);
+}
+
+inline uint8_t Mapper9::ppuRead(uint16_t addr) {
+    uint8_t v = BankedMapper::ppuRead(addr);
+    // The latch flips after the fetch: on $0FD8/$0FE8 for the left half,
+    // anywhere in $1FD8-$1FDF/$1FE8-$1FEF for the right half.
+    uint16_t tile = addr & 0x0FF8;
+    if (tile == 0x0FD8 || tile == 0x0FE8) {
+        int half = (addr >> 12) & 1;
+        if (half == 1 || (addr & 7) == 0) {
+            latchFE[half] = (addr & 0x0020) != 0;
+            mapCHR4(half, chrRegs[half * 2 + (latchFE[half] ? 1 : 0)]);
+        }
+    }
+    return v;
+}
+
+// ===========================
+// Dispatch
+// ===========================
+using Mapper = std::variant<Mapper0, Mapper1, Mapper2, Mapper3, Mapper4,
+    Mapper7, Mapper9, Mapper11, Mapper66>;
+
+// Factory to create the appropriate mapper by ID
+Mapper createMapper(uint16_t mapperID);
+
+// Call f(concreteMapper&). A switch on the variant index, so dispatch is
+// one jump however many boards there are, and because the index never
+// changes while a cartridge is inserted the branch predicts well; each
+// arm calls the concrete class directly so its accessors can inline.
+#define NESKA_MAPPER_CASE(I) \
+    case I: if constexpr (I < N) return f(*std::get_if<I>(&mapper)); else break;
+
+template <typename V, typename F>
+inline decltype(auto) visitMapper(V& mapper, F&& f) {
+    constexpr size_t N = std::variant_size_v<std::remove_const_t<V>>;
+    static_assert(N <= 12, "add cases to visitMapper");
+    switch (mapper.index()) {
+    NESKA_MAPPER_CASE(0)
+    NESKA_MAPPER_CASE(1)
+    NESKA_MAPPER_CASE(2)
+    NESKA_MAPPER_CASE(3)
+    NESKA_MAPPER_CASE(4)
+    NESKA_MAPPER_CASE(5)
+    NESKA_MAPPER_CASE(6)
+    NESKA_MAPPER_CASE(7)
+    NESKA_MAPPER_CASE(8)
+    NESKA_MAPPER_CASE(9)
+    NESKA_MAPPER_CASE(10)
+    NESKA_MAPPER_CASE(11)
+    }
+    // The index is always one of the cases above
+#if defined(_MSC_VER)
+    __assume(0);
+#else
+    __builtin_unreachable();
+#endif
+}
+
+#undef NESKA_MAPPER_CASE
@@ -2,20 +2,27 @@
 #include "memory.h"
 #include "cpu.h"
 #include "ppu.h"
+#include "apu.h"
 #include "mapper.h"
+#include "rom.h"
+#include "latency.h"
+#include "liveinput.h"
 
-#include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <cctype>
+#include <iterator>
 
 Memory::Memory()
-    : ram(0x0800, 0),
-    strobe(false),
-    controllerState(0),
-    controllerShift(0),
+    : MemoryState(),
+    liveInput(nullptr),
+    latency(nullptr),
     ppu(nullptr),
-    cpu(nullptr)
+    cpu(nullptr),
+    apu(nullptr),
+    cartridgeLoaded(false),
+    mapperID(0),
+    romHash(0)
 {
 }
 
@@ -27,100 +34,44 @@ void Memory::setCPU(CPU* c) {
     cpu = c;
 }
 
-MirrorMode Memory::loadROM(const std::string& filename, std::vector<uint8_t>& chrRomOut) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        std::cerr << "Unable to open ROM: " << filename << "\n";
-        return MirrorMode::HORIZONTAL;
-    }
-
-    // Read entire file into buffer
-    file.seekg(0, std::ios::end);
-    size_t fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-    std::vector<uint8_t> buffer(fileSize);
-    file.read(reinterpret_cast<char*>(buffer.data()), fileSize);
-    file.close();
-
-    if (fileSize < 16) {
-        std::cerr << "File too small for iNES header.\n";
-        return MirrorMode::HORIZONTAL;
-    }
-
-    // Validate iNES signature "NES" 0x1A
-    if (!(buffer[0] == 'N' && buffer[1] == 'E' && buffer[2] == 'S' && buffer[3] == 0x1A)) {
-        std::cerr << "Not a valid iNES ROM.\n";
-        return MirrorMode::HORIZONTAL;
-    }
-
-    bool isINES2 = ((buffer[7] & 0x0C) == 0x08);
-
-    uint8_t prgBanks = buffer[4];
-    uint8_t chrBanks = buffer[5];
-    uint8_t flags6 = buffer[6];
-    uint8_t flags7 = buffer[7];
-
-    bool hasTrainer = (flags6 & 0x04) != 0;
-    bool fourScreen = (flags6 & 0x08) != 0;
-
-    MirrorMode mirror;
-    if (fourScreen) {
-        mirror = MirrorMode::FOUR_SCREEN;
-    }
-    else {
-        bool vert = (flags6 & 0x01) != 0;
-        mirror = vert ? MirrorMode::VERTICAL : MirrorMode::HORIZONTAL;
-    }
-
-    uint8_t mapperLow = (flags6 >> 4) & 0x0F;
-    uint8_t mapperHigh = flags7 & 0xF0;
-    uint8_t mapperID = mapperHigh | mapperLow;
+void Memory::setAPU(APU* a) {
+    apu = a;
+}
 
-    if (isINES2) {
-        uint8_t mapperExt = buffer[8] & 0x0F;
-        mapperID |= mapperExt << 4;
-    }
+MirrorMode Memory::loadROM(const std::string& filename) {
+    auto rom = loadRomImage(filename);
+    if (!rom) return MirrorMode::HORIZONTAL;
+    return loadROM(std::move(rom));
+}
 
-    const size_t headerSize = 16;
-    size_t trainerSize = hasTrainer ? 512 : 0;
-    size_t prgSize = size_t(prgBanks) * 0x4000; // 16KB each
-    size_t chrSize = size_t(chrBanks) * 0x2000; //  8KB each
-    size_t prgOffset = headerSize + trainerSize;
-    size_t chrOffset = prgOffset + prgSize;
+MirrorMode Memory::loadROM(std::shared_ptr<const RomImage> rom) {
+    const RomHeader& header = rom->header;
+    initCartridge(rom);
 
-    if (buffer.size() < prgOffset + prgSize + chrSize) {
-        std::cerr << "ROM file seems truncated.\n";
-        // still initialize what we can
-    }
+    std::cout << "Loaded ROM: PRG=" << header.prgSize / 1024
+        << "KB, CHR=" << header.chrSize / 1024
+        << "KB, Mapper=" << header.mapperID;
+    if (header.nes2) std::cout << "." << int(header.submapper);
+    std::cout << ", Mirror=" << (header.mirror == MirrorMode::VERTICAL ? "Vertical" : "Horizontal")
+        << "\n";
 
-    // Extract PRG data
-    std::vector<uint8_t> prgData(prgSize);
-    std::copy_n(buffer.begin() + prgOffset, prgSize, prgData.begin());
+    return header.mirror;
+}
 
-    // Extract CHR data or allocate CHR RAM
-    std::vector<uint8_t> chrData;
-    if (chrSize == 0) {
-        chrData.resize(0x2000, 0);
-    }
-    else {
-        chrData.resize(chrSize);
-        std::copy_n(buffer.begin() + chrOffset, chrSize, chrData.begin());
-    }
+void Memory::initCartridge(const std::shared_ptr<const RomImage>& rom) {
+    romHash = rom->hash;
+    mapperID = rom->header.mapperID;
 
-    // Initialize mapper
+    // Initialize mapper; it reads PRG/CHR in place and keeps 'rom' alive
     mapper = createMapper(mapperID);
-    mapper->initMapper(prgBanks, chrBanks, prgData, chrData);
-
-    // Return CHR contents for PPU
-    chrRomOut = std::move(chrData);
-
-    std::cout << "Loaded ROM: PRG=" << int(prgBanks)
-        << "×16KB, CHR=" << int(chrBanks)
-        << "×8KB, Mapper=" << int(mapperID)
-        << ", Mirror=" << (mirror == MirrorMode::VERTICAL ? "Vertical" : "Horizontal")
-        << "\n";
+    visitMapper(mapper, [&](auto& m) { m.initMapper(rom); });
+    cartridgeLoaded = true;
+}
 
-    return mirror;
+void Memory::powerOn(const std::shared_ptr<const RomImage>& rom, uint8_t ramFill) {
+    static_cast<MemoryState&>(*this) = MemoryState();
+    fillRAM(ramFill);
+    if (rom) initCartridge(rom);
 }
 
 uint8_t Memory::read(uint16_t addr) {
@@ -135,13 +86,20 @@ uint8_t Memory::read(uint16_t addr) {
     // APU & I/O
     if (addr < 0x4020) {
         switch (addr) {
-        case 0x4016: return readController();
-        case 0x4017: return readSecondController();
+        case 0x4015: return apu ? apu->readStatus() : openBus();
+        case 0x4016: return readController(0);
+        case 0x4017: return readController(1);
         default:     return openBus();
         }
     }
     // Cartridge (PRG-ROM/RAM, bank switching)
-    return mapper->cpuRead(addr);
+    return visitMapper(mapper, [addr](auto& m) { return m.cpuRead(addr); });
+}
+
+uint8_t Memory::peek(uint16_t addr) {
+    if (addr < 0x2000) return ram[addr & 0x07FF];
+    if (addr < 0x4020 || !cartridgeLoaded) return 0;
+    return visitMapper(mapper, [addr](auto& m) { return m.cpuRead(addr); });
 }
 
 void Memory::write(uint16_t addr, uint8_t val) {
@@ -165,49 +123,62 @@ void Memory::write(uint16_t addr, uint8_t val) {
             strobeController(val);
             break;
         default:
-            // Other APU or I/O writes…
+            // $4000-$4013, $4015, $4017: sound and frame counter
+            if (addr <= 0x4017 && apu) apu->writeRegister(addr, val);
             break;
         }
         return;
     }
     // Cartridge
-    mapper->cpuWrite(addr, val);
+    visitMapper(mapper, [addr, val](auto& m) { m.cpuWrite(addr, val); });
+    syncCartridgeSignals();
 }
 
-uint8_t Memory::ppuRead(uint16_t addr) const {
+void Memory::clockScanline() {
+    visitMapper(mapper, [](auto& m) { m.clockScanline(); });
+    syncCartridgeSignals();
+}
+
+void Memory::syncCartridgeSignals() {
+    visitMapper(mapper, [this](auto& m) {
+        MirrorMode mode;
+        if (m.mirroring(mode)) ppu->setMirrorMode(mode);
+        cpu->setIrq(IRQ_MAPPER, m.irqPending());
+    });
+}
+
+uint8_t Memory::ppuRead(uint16_t addr) {
     if (addr < 0x2000) {
         // CHR → straight to mapper
-        return mapper->ppuRead(addr);
+        return chrRead(addr);
     }
     // Nametables & palette → let the PPU handle mirroring + buffer
     return ppu->vramRead(addr);
 }
 
-void Memory::ppuWrite(uint16_t addr, uint8_t val) const {
+void Memory::ppuWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
-        mapper->ppuWrite(addr, val);
+        visitMapper(mapper, [addr, val](auto& m) { m.ppuWrite(addr, val); });
     }
     else {
         ppu->vramWrite(addr, val);
     }
 }
 
-uint8_t Memory::readController() {
-    uint8_t bit = controllerShift & 1;
-    controllerShift >>= 1;
+uint8_t Memory::readController(int port) {
+    uint8_t bit = controllerShift[port] & 1;
+    controllerShift[port] >>= 1;
     // upper bits open bus
     return bit | 0x40;
 }
 
-uint8_t Memory::readSecondController() {
-    // No second controller implemented; open bus upper bits
-    return 0x40;
-}
-
 void Memory::strobeController(uint8_t val) {
     bool newStrobe = (val & 1) != 0;
     if (newStrobe) {
-        controllerShift = controllerState;
+        if (liveInput) controllerState[0] = liveInput->state();
+        controllerShift[0] = controllerState[0];
+        controllerShift[1] = controllerState[1];
+        if (latency) latency->latched(controllerState[0]);
     }
     strobe = newStrobe;
 }
@@ -215,11 +186,30 @@ void Memory::strobeController(uint8_t val) {
 void Memory::runOamDma(uint8_t page) {
     if (!ppu || !cpu) return;
     uint16_t base = uint16_t(page) << 8;
-    for (int i = 0; i < 256; i++) {
-        uint8_t data = read(base + i);
-        ppu->writeOAM(data);
+
+    // RAM, PRG-ROM and PRG-RAM pages are copied in one block; register
+    // and open-bus pages go through the bus byte by byte
+    const uint8_t* src = nullptr;
+    if (base < 0x2000) {
+        src = ram + (base & 0x0700);
+    }
+    else if (base >= 0x6000 && cartridgeLoaded) {
+        src = visitMapper(mapper, [base](const auto& m) { return m.cpuPage(base); });
     }
-    cpu->stallCycles = 513;  // 512 or 513 on odd cycles
+    if (src) {
+        ppu->writeOAMPage(src);
+    }
+    else {
+        for (int i = 0; i < 256; i++) {
+            ppu->writeOAM(read(uint16_t(base + i)));
+        }
+    }
+
+    // One halt cycle after the write, one more if that lands on an odd
+    // (put) cycle so the transfer starts on a read, then 256 read/write
+    // pairs: 513 or 514 cycles
+    uint64_t haltCycle = cpu->totalCycles + uint64_t(cpu->cyclesRemaining);
+    cpu->stall(513 + int(haltCycle & 1));
 }
 
 uint8_t Memory::openBus() const {
@@ -227,12 +217,53 @@ uint8_t Memory::openBus() const {
     return 0;
 }
 
+uint8_t* Memory::getPRGRAM(size_t& size) {
+    size = 0;
+    if (!cartridgeLoaded) return nullptr;
+    return visitMapper(mapper, [&size](auto& m) { return m.prgRamData(size); });
+}
+
+void Memory::attachPRGRAM(uint8_t* ram) {
+    if (!cartridgeLoaded) return;
+    visitMapper(mapper, [ram](auto& m) { m.attachPrgRam(ram); });
+}
+
+uint32_t Memory::takePRGRAMDirty() {
+    if (!cartridgeLoaded) return 0;
+    return visitMapper(mapper, [](auto& m) { return m.takePrgRamDirty(); });
+}
+
+void Memory::saveState(StateWriter& w) const {
+    w.write(static_cast<const MemoryState&>(*this));
+}
+
+void Memory::loadState(StateReader& r) {
+    r.read(static_cast<MemoryState&>(*this));
+}
+
+void Memory::saveCartridgeState(StateWriter& w) const {
+    w.write(mapperID);
+    if (cartridgeLoaded) visitMapper(mapper, [&w](const auto& m) { m.saveState(w); });
+}
+
+void Memory::loadCartridgeState(StateReader& r) {
+    uint16_t id = 0;
+    r.read(id);
+    if (id != mapperID) return;  // caller validated section sizes already
+    if (cartridgeLoaded) visitMapper(mapper, [&r](auto& m) { m.loadState(r); });
+    syncCartridgeSignals();
+}
+
+void Memory::fillRAM(uint8_t value) {
+    std::fill(std::begin(ram), std::end(ram), value);
+}
+
 void Memory::setButtonPressed(int bit) {
     if (bit >= 0 && bit < 8)
-        controllerState |= (1 << bit);
+        controllerState[0] |= (1 << bit);
 }
 
 void Memory::clearButtonPressed(int bit) {
     if (bit >= 0 && bit < 8)
-        controllerState &= ~(1 << bit);
+        controllerState[0] &= ~(1 << bit);
 }
\ No newline at end of file
@@ -7,52 +7,136 @@
 #include <string>
 #include "core.h"
 #include "mapper.h"
+#include "rom.h"
 
 // forward
 class CPU;
 class PPU;
+class APU;
+class LatencyTracker;
+class LiveInput;
 
-class Memory {
+// Everything a snapshot of Memory holds, in one block that the CPU's RAM
+// accesses stay inside. Plain data, so the snapshot is a single copy;
+// back-pointers and the cartridge live in Memory itself.
+struct alignas(64) MemoryState {
+    // 2 KB internal RAM
+    uint8_t ram[0x0800];
+
+    // Controller strobe & shift registers, one per port
+    uint8_t controllerState[2];
+    uint8_t controllerShift[2];
+    bool    strobe;
+};
+
+class Memory : private MemoryState {
 public:
     Memory();
 
     // Must be called immediately after constructing PPU/CPU
     void setPPU(PPU* p);
     void setCPU(CPU* p);
+    void setAPU(APU* p);
 
     // Load an iNES file, initialize the mapper, and return the mirroring mode.
-    // chrRomOut will be filled with CHR data (or CHR‑RAM contents).
-    MirrorMode loadROM(const std::string& path, std::vector<uint8_t>& chrRomOut);
+    // The mapper shares the image's PRG/CHR rather than copying them.
+    MirrorMode loadROM(const std::string& path);
+    MirrorMode loadROM(std::shared_ptr<const RomImage> rom);
 
     // CPU‐side bus access
     uint8_t read(uint16_t addr);
+
+    // Side-effect-free read for tracers and debuggers: RAM and cartridge
+    // space only, I/O registers read as 0.
+    uint8_t peek(uint16_t addr);
     void    write(uint16_t addr, uint8_t val);
 
     // PPU‐side bus access
-    uint8_t ppuRead(uint16_t addr)  const;
-    void    ppuWrite(uint16_t addr, uint8_t val) const;
+    uint8_t ppuRead(uint16_t addr);
+    void    ppuWrite(uint16_t addr, uint8_t val);
+
+    // PPU A12 rising edge (once per rendered scanline) for mappers with
+    // scanline counters.
+    void clockScanline();
+    bool usesScanlineCounter() const {
+        return visitMapper(mapper, [](const auto& m) {
+            return std::decay_t<decltype(m)>::hasScanlineCounter;
+        });
+    }
+
+    // Pattern-table fetch ($0000-$1FFF only), inlined into the PPU's
+    // fetch loops.
+    uint8_t chrRead(uint16_t addr) {
+        return visitMapper(mapper, [addr](auto& m) { return m.ppuRead(addr); });
+    }
 
     void setButtonPressed(int bit);
     void clearButtonPressed(int bit);
-private:
-    // 2 KB internal RAM
-    std::vector<uint8_t> ram;
 
-    // Controller strobe & shift register
-    bool    strobe;
-    uint8_t controllerState;
-    uint8_t controllerShift;
+    // Whole controller byte (bit 0 = A ... bit 7 = Right) of port 0
+    // ($4016) or port 1 ($4017), for movie playback and netplay.
+    void    setControllerState(uint8_t state, int port = 0) { controllerState[port & 1] = state; }
+    uint8_t getControllerState(int port = 0) const { return controllerState[port & 1]; }
 
-    // PPU & CPU pointers for I/O
+    // Latch 'input' into port 0 at each $4016 strobe instead of the controller byte
+    // set between frames; null to go back.
+    void setLiveInput(const LiveInput* input) { liveInput = input; }
+
+    // Report each controller latch (a $4016 strobe) to 'tracker'; null
+    // to stop.
+    void setLatencyTracker(LatencyTracker* tracker) { latency = tracker; }
+
+    // Power-on: fill internal RAM with 'ramFill', release the controller
+    // ports and rebuild the mapper from 'rom' (registers, IRQ, PRG-RAM and
+    // CHR-RAM as after loading). Call before CPU::powerOn().
+    void powerOn(const std::shared_ptr<const RomImage>& rom, uint8_t ramFill);
+
+    // Power-on contents of internal RAM. Call before CPU::reset().
+    void fillRAM(uint8_t value);
+    const uint8_t* getRAM() const { return ram; }
+    uint8_t*       getRAM() { return ram; }
+
+    // Cartridge work RAM ($6000-$7FFF); nullptr before a ROM is loaded.
+    uint8_t* getPRGRAM(size_t& size);
+
+    // Battery support: back PRG-RAM with external memory (8 KB), and
+    // collect the 1 KB blocks written since the last call.
+    void     attachPRGRAM(uint8_t* ram);
+    uint32_t takePRGRAMDirty();
+
+    // Snapshot support: RAM and controller latch; the cartridge (mapper
+    // registers, PRG-RAM, CHR-RAM) is a separate section.
+    void saveState(StateWriter& w) const;
+    void loadState(StateReader& r);
+    void saveCartridgeState(StateWriter& w) const;
+    void loadCartridgeState(StateReader& r);
+    uint16_t getMapperID() const { return mapperID; }
+
+    // CRC-32 of the loaded PRG+CHR data (header excluded).
+    uint32_t getROMHash() const { return romHash; }
+private:
+    const LiveInput* liveInput;
+    LatencyTracker*  latency;
+
+    // PPU, CPU & APU pointers for I/O
     PPU* ppu;
     CPU* cpu;
+    APU* apu;
 
     // Cartridge logic
-    std::unique_ptr<Mapper> mapper;
+    Mapper   mapper;
+    bool     cartridgeLoaded;
+    uint16_t mapperID;
+    uint32_t romHash;
+
+    // Create the mapper for 'rom' in its power-on state.
+    void initCartridge(const std::shared_ptr<const RomImage>& rom);
+
+    // Push the mapper's mirroring and IRQ level to the PPU and CPU.
+    void syncCartridgeSignals();
 
     // Helpers
-    uint8_t readController();
-    uint8_t readSecondController();
+    uint8_t readController(int port);
     void    strobeController(uint8_t val);
     void    runOamDma(uint8_t page);
     uint8_t openBus() const;
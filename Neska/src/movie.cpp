@@ -0,0 +1,100 @@
+// movie.cpp
+#include "movie.h"
+#include "checksum.h"
+#include "ppu.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+void putLE32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(uint8_t(v >> (i * 8)));
+}
+
+uint32_t getLE32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+} // namespace
+
+void Movie::addFrame(const uint8_t* portStates, uint64_t hash) {
+    inputs.insert(inputs.end(), portStates, portStates + ports);
+    if (hasHashes) hashes.push_back(hash);
+}
+
+bool saveMovie(const std::string& path, const Movie& movie) {
+    std::vector<uint8_t> out;
+    const uint32_t frames = movie.frameCount();
+    out.reserve(16 + size_t(frames) * (movie.ports + (movie.hasHashes ? 8 : 0)));
+
+    out.insert(out.end(), { 'N', 'K', 'M', 'V', Movie::VERSION, movie.ports,
+        uint8_t(movie.hasHashes ? 1 : 0), movie.ramFill });
+    putLE32(out, movie.romHash);
+    putLE32(out, frames);
+
+    for (uint32_t f = 0; f < frames; ++f) {
+        for (int p = 0; p < movie.ports; ++p) out.push_back(movie.input(f, p));
+        if (movie.hasHashes) {
+            uint64_t h = movie.hashes[f];
+            for (int i = 0; i < 8; ++i) out.push_back(uint8_t(h >> (i * 8)));
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to write movie: " << path << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    return bool(file);
+}
+
+bool loadMovie(const std::string& path, Movie& movie) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open movie: " << path << "\n";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < 16 || data[0] != 'N' || data[1] != 'K' || data[2] != 'M' || data[3] != 'V') {
+        std::cerr << "Not a Neska movie: " << path << "\n";
+        return false;
+    }
+    if (data[4] != Movie::VERSION) {
+        std::cerr << "Unsupported movie version " << int(data[4]) << "\n";
+        return false;
+    }
+
+    movie.ports = data[5];
+    movie.hasHashes = (data[6] & 1) != 0;
+    movie.ramFill = data[7];
+    movie.romHash = getLE32(&data[8]);
+    uint32_t frames = getLE32(&data[12]);
+
+    const size_t record = size_t(movie.ports) + (movie.hasHashes ? 8 : 0);
+    if (movie.ports == 0 || data.size() < 16 + size_t(frames) * record) {
+        std::cerr << "Movie file seems truncated.\n";
+        return false;
+    }
+
+    movie.inputs.clear();
+    movie.hashes.clear();
+    movie.inputs.reserve(size_t(frames) * movie.ports);
+    const uint8_t* p = data.data() + 16;
+    for (uint32_t f = 0; f < frames; ++f, p += record) {
+        movie.inputs.insert(movie.inputs.end(), p, p + movie.ports);
+        if (movie.hasHashes) {
+            uint64_t h = 0;
+            for (int i = 0; i < 8; ++i) h |= uint64_t(p[movie.ports + i]) << (i * 8);
+            movie.hashes.push_back(h);
+        }
+    }
+    return true;
+}
+
+uint64_t frameHash(const uint32_t* frameBuffer, const uint8_t* ram) {
+    uint64_t h = hash64(frameBuffer, sizeof(uint32_t) * SCREEN_WIDTH * SCREEN_HEIGHT);
+    return hash64(ram, 0x0800, h);
+}
@@ -0,0 +1,38 @@
+// movie.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic input recording. A movie stores everything needed to replay
+// a run bit-for-bit: the ROM it was made against, the power-on state and
+// one controller byte per port per frame. Optional per-frame fingerprints
+// (framebuffer + RAM) let playback prove that the replay did not diverge.
+//
+// NKMV layout (little endian):
+//   "NKMV", u8 version, u8 ports, u8 flags (bit0 = hashes), u8 ramFill,
+//   u32 romHash, u32 frameCount,
+//   then per frame: 'ports' input bytes [+ u64 hash if flagged]
+struct Movie {
+    static const uint8_t VERSION = 1;
+
+    uint8_t  ports = 1;
+    uint8_t  ramFill = 0;      // power-on value of internal RAM
+    uint32_t romHash = 0;      // Memory::getROMHash() at record time
+    bool     hasHashes = false;
+
+    std::vector<uint8_t>  inputs;   // frameCount * ports
+    std::vector<uint64_t> hashes;   // frameCount entries when hasHashes
+
+    uint32_t frameCount() const { return ports ? uint32_t(inputs.size() / ports) : 0; }
+    uint8_t  input(uint32_t frame, int port = 0) const { return inputs[size_t(frame) * ports + port]; }
+
+    void addFrame(const uint8_t* portStates, uint64_t hash = 0);
+};
+
+bool saveMovie(const std::string& path, const Movie& movie);
+bool loadMovie(const std::string& path, Movie& movie);
+
+// Fingerprint of the state a game can show or keep: framebuffer and RAM.
+uint64_t frameHash(const uint32_t* frameBuffer, const uint8_t* ram);
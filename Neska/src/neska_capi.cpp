@@ -0,0 +1,125 @@
+// neska_capi.cpp
+#define NESKA_BUILDING_LIBRARY
+#include "neska.h"
+#include "machine.h"
+
+#include <cstring>
+#include <new>
+
+// The opaque handle is the machine itself.
+struct neska_machine {
+    Machine machine;
+    bool    hasRom = false;
+};
+
+static_assert(NESKA_SCREEN_WIDTH == SCREEN_WIDTH && NESKA_SCREEN_HEIGHT == SCREEN_HEIGHT,
+    "C ABI screen size out of sync with the PPU");
+
+extern "C" {
+
+uint32_t neska_abi_version(void) {
+    return NESKA_ABI_VERSION;
+}
+
+neska_machine* neska_create(void) {
+    return new (std::nothrow) neska_machine();
+}
+
+void neska_destroy(neska_machine* m) {
+    delete m;
+}
+
+int neska_load_rom(neska_machine* m, const uint8_t* data, size_t size) {
+    if (!m || !data) return NESKA_ERR_ARGUMENT;
+    auto rom = parseRomImage(data, size);
+    if (!rom) return NESKA_ERR_ROM;
+    m->machine.loadROM(std::move(rom));
+    m->machine.powerOn();
+    m->hasRom = true;
+    return NESKA_OK;
+}
+
+int neska_power_on(neska_machine* m, uint8_t ramFill) {
+    if (!m) return NESKA_ERR_ARGUMENT;
+    if (!m->hasRom) return NESKA_ERR_NO_ROM;
+    m->machine.powerOn(ramFill);
+    return NESKA_OK;
+}
+
+// 'inputs' holds 'ports' bytes per frame, port 0 first.
+static int stepPorts(neska_machine* m, const uint8_t* inputs, int ports, uint32_t frames, uint8_t* ramOut) {
+    if (!m) return NESKA_ERR_ARGUMENT;
+    if (!m->hasRom) return NESKA_ERR_NO_ROM;
+
+    Machine& machine = m->machine;
+    Memory& memory = machine.memory();
+    for (uint32_t f = 0; f < frames; ++f) {
+        for (int port = 0; inputs && port < ports; ++port) {
+            memory.setControllerState(inputs[size_t(f) * ports + port], port);
+        }
+        machine.runFrame();
+        if (ramOut) {
+            std::memcpy(ramOut + size_t(f) * 0x0800, memory.getRAM(), 0x0800);
+        }
+    }
+    return NESKA_OK;
+}
+
+int neska_step(neska_machine* m, const uint8_t* inputs, uint32_t frames, uint8_t* ramOut) {
+    return stepPorts(m, inputs, 1, frames, ramOut);
+}
+
+int neska_step2(neska_machine* m, const uint8_t* inputs, uint32_t frames, uint8_t* ramOut) {
+    return stepPorts(m, inputs, 2, frames, ramOut);
+}
+
+int neska_step_batch(neska_step_request* requests, size_t count) {
+    if (!requests && count) return NESKA_ERR_ARGUMENT;
+    int first = NESKA_OK;
+    for (size_t i = 0; i < count; ++i) {
+        neska_step_request& req = requests[i];
+        req.result = neska_step(req.machine, req.inputs, req.frames, req.ram_out);
+        if (req.result != NESKA_OK && first == NESKA_OK) first = req.result;
+    }
+    return first;
+}
+
+uint64_t neska_frame_count(const neska_machine* m) {
+    return m ? m->machine.frameCount() : 0;
+}
+
+const uint32_t* neska_framebuffer(const neska_machine* m) {
+    return m ? m->machine.getFrameBuffer() : nullptr;
+}
+
+uint8_t* neska_ram(neska_machine* m, size_t* size) {
+    if (size) *size = m ? 0x0800 : 0;
+    return m ? m->machine.memory().getRAM() : nullptr;
+}
+
+uint8_t* neska_prg_ram(neska_machine* m, size_t* size) {
+    size_t len = 0;
+    uint8_t* data = m ? m->machine.memory().getPRGRAM(len) : nullptr;
+    if (size) *size = len;
+    return data;
+}
+
+size_t neska_state_size(const neska_machine* m) {
+    return (m && m->hasRom) ? m->machine.stateSize() : 0;
+}
+
+int neska_save_state(const neska_machine* m, void* buffer, size_t size) {
+    if (!m || !buffer) return NESKA_ERR_ARGUMENT;
+    if (!m->hasRom) return NESKA_ERR_NO_ROM;
+    if (!m->machine.saveState(static_cast<uint8_t*>(buffer), size)) return NESKA_ERR_ARGUMENT;
+    return NESKA_OK;
+}
+
+int neska_load_state(neska_machine* m, const void* buffer, size_t size) {
+    if (!m || !buffer) return NESKA_ERR_ARGUMENT;
+    if (!m->hasRom) return NESKA_ERR_NO_ROM;
+    if (!m->machine.loadState(static_cast<const uint8_t*>(buffer), size)) return NESKA_ERR_STATE;
+    return NESKA_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,184 @@
+// netplay.cpp
+#include "netplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "machine.h"
+#include "transport.h"
+
+// Packet layout (little endian):
+//   "NKNP", u32 romHash, u32 ack (remote frames the sender has),
+//   u32 first (frame of inputs[0]), u8 count, inputs[count]
+static const uint32_t PACKET_MAGIC = 0x504E4B4E;  // "NKNP"
+static const uint64_t NO_ROLLBACK = ~uint64_t(0);
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); p[2] = uint8_t(v >> 16); p[3] = uint8_t(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+NetplaySession::NetplaySession(Machine& machine, Transport& transport, const NetplayConfig& config)
+    : machine(machine), transport(transport), config(config),
+    current(0), localQueued(0), remoteConfirmed(0), peerAcked(0), rollbackFrom(NO_ROLLBACK),
+    warnedRom(false)
+{
+    this->config.localPort &= 1;
+    this->config.maxRollback = std::max(1u, std::min(this->config.maxRollback, 32u));
+    this->config.inputDelay = std::min(this->config.inputDelay, 16u);
+
+    std::memset(localInputs, 0, sizeof(localInputs));
+    std::memset(remoteInputs, 0, sizeof(remoteInputs));
+    std::memset(usedRemote, 0, sizeof(usedRemote));
+    // The first 'inputDelay' frames run with nothing pressed
+    localQueued = this->config.inputDelay;
+
+    // One snapshot per frame that may still be corrected: the last
+    // confirmed frame up to the one about to run
+    stateSize = machine.stateSize();
+    snapshotSlots = this->config.maxRollback + 1;
+    snapshots.resize(stateSize * snapshotSlots);
+    packet.resize(PACKET_HEADER + MAX_BATCH);
+    discard.resize(4096);
+    romHash = machine.memory().getROMHash();
+}
+
+bool NetplaySession::advanceFrame(uint8_t localInput) {
+    receivePackets();
+    if (rollbackFrom != NO_ROLLBACK) rollback();
+
+    if (current - std::min(current, remoteConfirmed) >= config.maxRollback) {
+        statistics.stalls++;
+        sendInputs();
+        return false;
+    }
+
+    localInputs[localQueued % RING] = localInput;
+    localQueued++;
+    sendInputs();
+
+    runFrame(current);
+    current++;
+    statistics.frames++;
+    return true;
+}
+
+void NetplaySession::poll() {
+    receivePackets();
+    if (rollbackFrom != NO_ROLLBACK) rollback();
+    sendInputs();
+}
+
+void NetplaySession::receivePackets() {
+    uint8_t buffer[512];
+    while (size_t size = transport.receive(buffer, sizeof(buffer))) {
+        handlePacket(buffer, size);
+    }
+}
+
+void NetplaySession::handlePacket(const uint8_t* data, size_t size) {
+    if (size < PACKET_HEADER || getU32(data) != PACKET_MAGIC ||
+        size < PACKET_HEADER + data[16]) {
+        statistics.packetsRejected++;
+        return;
+    }
+    if (getU32(data + 4) != romHash) {
+        if (!warnedRom) {
+            std::cerr << "Netplay peer is running a different ROM\n";
+            warnedRom = true;
+        }
+        statistics.packetsRejected++;
+        return;
+    }
+    statistics.packetsReceived++;
+
+    // A peer cannot have more of our inputs than we have sent
+    uint64_t ack = std::min<uint64_t>(getU32(data + 8), localQueued);
+    peerAcked = std::max(peerAcked, ack);
+
+    // Take the inputs that extend the confirmed run; older ones are
+    // repeats, and a gap waits for a packet that fills it
+    uint64_t first = getU32(data + 12);
+    uint32_t count = data[16];
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t f = first + i;
+        if (f != remoteConfirmed) continue;
+        if (f >= current + RING / 2) break;  // peer impossibly far ahead
+        uint8_t input = data[PACKET_HEADER + i];
+        remoteInputs[f % RING] = input;
+        remoteConfirmed++;
+        if (f < current && usedRemote[f % RING] != input) {
+            rollbackFrom = std::min(rollbackFrom, f);
+        }
+    }
+}
+
+void NetplaySession::sendInputs() {
+    // Everything the peer has not confirmed, oldest first. The two sides
+    // can get at most 2 * (inputDelay + maxRollback) + 2 = 98 frames apart,
+    // so that is still in the ring, and a packet sends the first 96.
+    uint64_t first = std::max(peerAcked, localQueued - std::min<uint64_t>(localQueued, RING));
+    uint32_t count = uint32_t(std::min<uint64_t>(localQueued - first, MAX_BATCH));
+
+    uint8_t* p = packet.data();
+    putU32(p, PACKET_MAGIC);
+    putU32(p + 4, romHash);
+    putU32(p + 8, uint32_t(remoteConfirmed));
+    putU32(p + 12, uint32_t(first));
+    p[16] = uint8_t(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        p[PACKET_HEADER + i] = localInputs[(first + i) % RING];
+    }
+    if (transport.send(p, PACKET_HEADER + count)) statistics.packetsSent++;
+}
+
+void NetplaySession::rollback() {
+    uint64_t from = rollbackFrom;
+    rollbackFrom = NO_ROLLBACK;
+
+    auto start = std::chrono::steady_clock::now();
+    if (!machine.loadState(snapshot(from), stateSize)) {
+        std::cerr << "Netplay rollback to frame " << from << " failed\n";
+        return;
+    }
+    // Re-run frames are never shown, and the sound of the mispredicted
+    // ones has been heard already
+    APU& apu = machine.apu();
+    PPU& ppu = machine.ppu();
+    bool pixels = ppu.pixelOutputEnabled();
+    ppu.setPixelOutput(false);
+    for (uint64_t f = from; f < current; ++f) {
+        runFrame(f);
+        while (apu.readSamples(discard.data(), discard.size()) > 0) {}
+    }
+    ppu.setPixelOutput(pixels);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t depth = uint32_t(current - from);
+    statistics.rollbacks++;
+    statistics.resimulated += depth;
+    statistics.maxDepth = std::max(statistics.maxDepth, depth);
+    statistics.maxRollbackMs = std::max(statistics.maxRollbackMs, ms);
+}
+
+void NetplaySession::runFrame(uint64_t f) {
+    // Keep a way back from every frame that still runs on a guess
+    bool predicted = f >= remoteConfirmed;
+    if (predicted) machine.saveState(snapshot(f), stateSize);
+
+    uint8_t remote = predicted ? predictRemote() : remoteInputs[f % RING];
+    usedRemote[f % RING] = remote;
+
+    Memory& memory = machine.memory();
+    memory.setControllerState(localInputs[f % RING], config.localPort);
+    memory.setControllerState(remote, config.localPort ^ 1);
+    machine.runFrame();
+}
+
+uint8_t NetplaySession::predictRemote() const {
+    return remoteConfirmed > 0 ? remoteInputs[(remoteConfirmed - 1) % RING] : 0;
+}
@@ -0,0 +1,104 @@
+// netplay.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Machine;
+class Transport;
+
+struct NetplayConfig {
+    int      localPort = 0;     // controller port this side plays (0 or 1)
+    uint32_t inputDelay = 1;    // frames between reading a key and using it
+    uint32_t maxRollback = 8;   // frames run ahead on predicted input (1-32)
+};
+
+struct NetplayStats {
+    uint64_t frames = 0;        // frames advanced
+    uint64_t stalls = 0;        // advanceFrame() calls that waited for the peer
+    uint64_t rollbacks = 0;     // mispredictions corrected
+    uint64_t resimulated = 0;   // frames re-run by those corrections
+    uint32_t maxDepth = 0;      // deepest rollback, in frames
+    double   maxRollbackMs = 0; // slowest correction, restore included
+    uint64_t packetsSent = 0;
+    uint64_t packetsReceived = 0;
+    uint64_t packetsRejected = 0;  // malformed or for another ROM
+};
+
+// Two-player rollback session over a Transport. Both peers run the same
+// ROM from power-on and exchange only controller bytes.
+//
+// Each frame runs immediately with the local input and a prediction of
+// the remote one (the last input received). When the real input arrives
+// and differs from what was predicted, the machine goes back to the
+// snapshot taken before that frame and re-runs every frame since with the
+// corrected inputs, all within the current advanceFrame() call and with
+// the PPU's pixel output off. Snapshots are taken only of frames that
+// still depend on a prediction. A side never predicts more than
+// 'maxRollback' frames ahead of the last confirmed remote input; beyond
+// that it stalls until the peer catches up, which bounds the cost of one
+// correction.
+//
+// Every packet repeats the local inputs the peer has not acknowledged,
+// so lost datagrams heal on the next one that gets through.
+class NetplaySession {
+public:
+    NetplaySession(Machine& machine, Transport& transport,
+        const NetplayConfig& config = NetplayConfig());
+
+    NetplaySession(const NetplaySession&) = delete;
+    NetplaySession& operator=(const NetplaySession&) = delete;
+
+    // Exchange inputs and run the next frame with 'localInput' (applied
+    // 'inputDelay' frames later). Returns false without running anything
+    // when the remote input is too far behind; call again on the next
+    // tick with the current input.
+    bool advanceFrame(uint8_t localInput);
+
+    // Exchange inputs and apply any correction without running a new
+    // frame, e.g. while paused or to settle the last frames of a session.
+    void poll();
+
+    // Frames run so far, and how many of them used only confirmed input.
+    uint64_t frame() const { return current; }
+    uint64_t confirmedFrames() const { return remoteConfirmed < current ? remoteConfirmed : current; }
+
+    const NetplayStats& stats() const { return statistics; }
+
+private:
+    static const uint32_t RING = 128;         // input history, in frames
+    static const uint32_t MAX_BATCH = 96;     // inputs per packet
+    static const size_t   PACKET_HEADER = 17;
+
+    void     receivePackets();
+    void     handlePacket(const uint8_t* data, size_t size);
+    void     sendInputs();
+    void     rollback();
+    void     runFrame(uint64_t f);
+    uint8_t  predictRemote() const;
+    uint8_t* snapshot(uint64_t f) { return snapshots.data() + (f % snapshotSlots) * stateSize; }
+
+    Machine&      machine;
+    Transport&    transport;
+    NetplayConfig config;
+    NetplayStats  statistics;
+
+    uint64_t current;           // next frame to run
+    uint64_t localQueued;       // local inputs known for frames below this
+    uint64_t remoteConfirmed;   // remote inputs known for frames below this
+    uint64_t peerAcked;         // local inputs the peer has confirmed
+    uint64_t rollbackFrom;      // earliest mispredicted frame, or NO_ROLLBACK
+
+    uint8_t localInputs[RING];
+    uint8_t remoteInputs[RING];
+    uint8_t usedRemote[RING];   // what each run frame was given
+
+    size_t               stateSize;
+    size_t               snapshotSlots;
+    std::vector<uint8_t> snapshots;
+    std::vector<uint8_t> packet;
+    std::vector<int16_t> discard;   // audio of re-run frames
+    uint32_t             romHash;
+    bool                 warnedRom;
+};
@@ -0,0 +1,136 @@
+// png.cpp
+#include "png.h"
+#include "checksum.h"
+
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+
+void putBE32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(uint8_t(v >> 24));
+    out.push_back(uint8_t(v >> 16));
+    out.push_back(uint8_t(v >> 8));
+    out.push_back(uint8_t(v));
+}
+
+void writeChunk(std::vector<uint8_t>& out, const char type[4],
+    const uint8_t* data, size_t size) {
+    putBE32(out, uint32_t(size));
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    uint32_t crc = crc32(out.data() + typeStart, size + 4);
+    putBE32(out, crc);
+}
+
+// Wrap raw scanlines in a zlib stream made of stored (uncompressed) blocks.
+std::vector<uint8_t> zlibStore(const std::vector<uint8_t>& raw) {
+    const size_t MAX_BLOCK = 0xFFFF;
+    std::vector<uint8_t> z;
+    z.reserve(raw.size() + raw.size() / MAX_BLOCK * 5 + 16);
+    z.push_back(0x78);  // CMF: deflate, 32K window
+    z.push_back(0x01);  // FLG: no dictionary, fastest, (CMF*256+FLG) % 31 == 0
+
+    size_t pos = 0;
+    do {
+        size_t len = raw.size() - pos;
+        if (len > MAX_BLOCK) len = MAX_BLOCK;
+        bool last = (pos + len == raw.size());
+        z.push_back(last ? 1 : 0);
+        z.push_back(uint8_t(len));
+        z.push_back(uint8_t(len >> 8));
+        z.push_back(uint8_t(~len));
+        z.push_back(uint8_t(~len >> 8));
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+
+    putBE32(z, adler32(raw.data(), raw.size()));
+    return z;
+}
+
+} // namespace
+
+bool encodePNG(const uint32_t* argb, int width, int height, std::vector<uint8_t>& out) {
+    if (!argb || width <= 0 || height <= 0) return false;
+
+    const size_t pixelCount = size_t(width) * height;
+
+    // Try to build a palette; give up as soon as we see a 257th colour.
+    std::unordered_map<uint32_t, uint8_t> lookup;
+    std::vector<uint32_t> palette;
+    bool indexed = true;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        uint32_t rgb = argb[i] & 0x00FFFFFF;
+        if (lookup.find(rgb) != lookup.end()) continue;
+        if (palette.size() == 256) {
+            indexed = false;
+            break;
+        }
+        lookup.emplace(rgb, uint8_t(palette.size()));
+        palette.push_back(rgb);
+    }
+
+    // Scanlines, each prefixed with filter type 0 (none).
+    const size_t stride = indexed ? size_t(width) : size_t(width) * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        const uint32_t* row = argb + size_t(y) * width;
+        for (int x = 0; x < width; ++x) {
+            uint32_t rgb = row[x] & 0x00FFFFFF;
+            if (indexed) {
+                raw.push_back(lookup[rgb]);
+            }
+            else {
+                raw.push_back(uint8_t(rgb >> 16));
+                raw.push_back(uint8_t(rgb >> 8));
+                raw.push_back(uint8_t(rgb));
+            }
+        }
+    }
+
+    out.clear();
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+
+    uint8_t ihdr[13];
+    ihdr[0] = uint8_t(width >> 24);  ihdr[1] = uint8_t(width >> 16);
+    ihdr[2] = uint8_t(width >> 8);   ihdr[3] = uint8_t(width);
+    ihdr[4] = uint8_t(height >> 24); ihdr[5] = uint8_t(height >> 16);
+    ihdr[6] = uint8_t(height >> 8);  ihdr[7] = uint8_t(height);
+    ihdr[8] = 8;                   // bit depth
+    ihdr[9] = indexed ? 3 : 2;     // colour type: palette or RGB
+    ihdr[10] = 0;                  // compression: deflate
+    ihdr[11] = 0;                  // filter method
+    ihdr[12] = 0;                  // no interlace
+    writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+    if (indexed) {
+        std::vector<uint8_t> plte;
+        plte.reserve(palette.size() * 3);
+        for (uint32_t rgb : palette) {
+            plte.push_back(uint8_t(rgb >> 16));
+            plte.push_back(uint8_t(rgb >> 8));
+            plte.push_back(uint8_t(rgb));
+        }
+        writeChunk(out, "PLTE", plte.data(), plte.size());
+    }
+
+    std::vector<uint8_t> idat = zlibStore(raw);
+    writeChunk(out, "IDAT", idat.data(), idat.size());
+    writeChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+bool writePNG(const std::string& path, const uint32_t* argb, int width, int height) {
+    std::vector<uint8_t> png;
+    if (!encodePNG(argb, width, height, png)) return false;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return bool(file);
+}
@@ -0,0 +1,15 @@
+// png.h
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// Minimal in-tree PNG encoder for screenshots. Frames with 256 colours or
+// fewer (every NES frame) are written as indexed PNGs; anything else falls
+// back to 24-bit RGB. Pixel data is stored with uncompressed deflate blocks,
+// so encoding is a couple of linear passes with no external dependency.
+bool encodePNG(const uint32_t* argb, int width, int height, std::vector<uint8_t>& out);
+
+// Encode and write to disk. Returns false if the file could not be written.
+bool writePNG(const std::string& path, const uint32_t* argb, int width, int height);
@@ -65,30 +65,18 @@ const uint32_t PPU::nesPalette[64] = {
 // ----------------
 
 PPU::PPU(MirrorMode mode, Logger& logger)
-    : mirrorMode(mode), memory(nullptr),
-    cycle(0), scanline(0), v(0), t(0), fineX(0), w(false),
-    readBuffer(0), nmiTriggered(false), oddFrame(false), reloadPending(false),
-    evaluatedSpriteCount(0), attribShiftLo(0), attribShiftHi(0),
-    patternShiftLo(0), patternShiftHi(0), nextTileID(0), nextTileAttr(0),
-    nextTileLo(0), nextTileHi(0), scrollX_coarse(0), scrollY_coarse(0),
-    scrollY_fine(0), sprite0HitFlag(false), sprite0HitPossible(false)
+    : PpuState(), logger(&logger), memory(nullptr),
+    frameBuffer(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFF000000),
+    pixelOutput(true)
 {
-    std::memset(registers, 0, sizeof(registers));
-    std::memset(vram, 0, sizeof(vram));
-    std::memset(oam, 0, sizeof(oam));
-    std::fill(std::begin(frameBuffer), std::end(frameBuffer), 0xFF000000);
+    // The state block is zeroed; only the non-zero defaults remain
+    mirrorMode = mode;
     flags.clear();
     std::memset(evaluatedSpriteIndices, 0xFF, sizeof(evaluatedSpriteIndices));
-    std::memset(spriteShiftLo, 0, sizeof(spriteShiftLo));
-    std::memset(spriteShiftHi, 0, sizeof(spriteShiftHi));
-    std::memset(spriteXCounter, 0, sizeof(spriteXCounter));
-    std::memset(spriteAttrs, 0, sizeof(spriteAttrs));
-
-    this->logger = &logger;
 
     //// Init palette RAM to identity.
     //for (int i = 0; i < 0x20; i++) {
-    //    vram[0x3F00 + i] = uint8_t(i & 0x3F);
+    //    palette[i] = uint8_t(i & 0x3F);
     //}
 }
 
@@ -116,14 +104,41 @@ void PPU::setMemory(Memory* mem) {
     memory = mem;
 }
 
+// Mapper scanline counters (MMC3) clock on PPU A12 rising. With 8x8
+// sprites that happens once per line at a dot fixed by the pattern table
+// selection, so it is raised there instead of by watching every fetch:
+// dot 260 for BG $0000 / sprites $1000, dot 324 for BG $1000 / sprites
+// $0000. 8x16 sprites count as $1000 (the usual setup); with both tables
+// equal A12 never rises cleanly. The emulator schedules both candidate
+// dots and calls clockScanlineCounter() once each has run.
+void PPU::clockScanlineCounter(int dot) {
+    if ((scanline < 240 || scanline == 261) && renderingEnabled() && dot == a12RiseDot()) {
+        memory->clockScanline();
+    }
+}
+
+int PPU::a12RiseDot() const {
+    bool bgHigh = registers[0] & 0x10;
+    bool spriteHigh = (registers[0] & 0x08) || (registers[0] & 0x20);
+    if (!bgHigh && spriteHigh) return 260;
+    if (bgHigh && !spriteHigh) return 324;
+    return 0;
+}
+
 void PPU::setMirrorMode(MirrorMode mode) {
     mirrorMode = mode;
 }
 
-void PPU::setCHR(uint8_t* chrData, size_t size) {
-    for (size_t i = 0; i < size && i < 0x2000; ++i) {
-        vram[i] = chrData[i];
-    }
+// ----------------
+// Snapshots
+// ----------------
+
+void PPU::saveState(StateWriter& out) const {
+    out.write(static_cast<const PpuState&>(*this));
+}
+
+void PPU::loadState(StateReader& in) {
+    in.read(static_cast<PpuState&>(*this));
 }
 
 // ----------------
@@ -134,7 +149,7 @@ void PPU::writeRegister(uint16_t addr, uint8_t val) {
     uint8_t reg = addr & 0x7;
     registers[reg] = val;
 
-    logger->logToConsole((const char*)addr);
+    logger->trace<TraceCategory::PPU>(TRACE_PPU_WRITE, addr, val);
 
     switch (reg) {
     case 0: // PPUCTRL ($2000)
@@ -221,7 +236,7 @@ uint8_t PPU::readRegister(uint16_t addr) {
         uint16_t addr = v & 0x3FFF;
         if (addr >= 0x3F00) {
             // Palette reads are immediate
-            value = vram[mirrorAddress(addr)];
+            value = palette[addr & 0x1F];
         }
         else {
             // buffered read
@@ -252,6 +267,14 @@ void PPU::writeOAM(uint8_t data) {
     registers[3] = addr;
 }
 
+// Same as 256 writeOAM() calls: the copy wraps at the end of OAM and
+// OAMADDR ends where it started.
+void PPU::writeOAMPage(const uint8_t* data) {
+    size_t start = registers[3];
+    std::memcpy(oam + start, data, 256 - start);
+    std::memcpy(oam, data + (256 - start), start);
+}
+
 // ----------------
 // Main clock step
 // ----------------
@@ -290,8 +313,12 @@ void PPU::stepDot() {
     }
 
     // Sprite fetch pipeline (dots 321–336) happens in evaluateSprites() and your sprite setup code
-    // Pixel rendering on visible scanlines
-    if (scanline < 240 && cycle >= 1 && cycle <= 256) {
+    // Pixel rendering on visible scanlines. Without pixel output only a
+    // sprite-0 hit is left to find; the sprite shifters the skipped dots
+    // would consume are reloaded by the next evaluation before any use
+    // that could still set the flag.
+    if (scanline < 240 && cycle >= 1 && cycle <= 256 &&
+        (pixelOutput || (sprite0HitPossible && !flags.sprite0Hit))) {
         renderPixel();
     }
 
@@ -302,6 +329,7 @@ void PPU::stepDot() {
         if (registers[0] & 0x80) {  // NMI enabled?
             nmiTriggered = true;
             flags.set(PPUStatusFlag::NMI);
+            logger->trace<TraceCategory::Interrupt>(TRACE_NMI, uint16_t(scanline), uint32_t(cycle));
         }
     }
 
@@ -336,7 +364,7 @@ void PPU::stepDot() {
 // ----------------
 
 void PPU::renderFrame() {
-    // nothing to do: emulator polls scanline/cycle for frame boundary
+    // nothing to do: the emulator schedules the frame boundary
 }
 
 // ----------------
@@ -344,11 +372,7 @@ void PPU::renderFrame() {
 // ----------------
 
 const uint32_t* PPU::getFrameBuffer() const {
-    return frameBuffer;
-}
-
-const uint8_t* PPU::getVRAM() const {
-    return vram;
+    return frameBuffer.data();
 }
 
 bool PPU::isNmiTriggered() const {
@@ -375,11 +399,16 @@ void PPU::evaluateSprites() {
     const int spriteHeight = (registers[0] & 0x20) ? 16 : 8;
     const uint8_t* OAM = oam;    // primary OAM, 64 entries × 4 bytes
 
-    // 1) scan primary OAM for sprites on this scanline
-    for (int i = 0; i < 64 && evaluatedSpriteCount < 8; ++i) {
+    // 1) scan primary OAM for sprites on this scanline; a ninth one on a
+    //    visible line sets the overflow flag
+    for (int i = 0; i < 64; ++i) {
         uint8_t y = OAM[i * 4 + 0];
         // sprite’s Y in OAM is “first row - 1”
         if (scanline >= (y + 1) && scanline < (y + 1 + spriteHeight)) {
+            if (evaluatedSpriteCount == 8) {
+                if (scanline < 240) flags.set(PPUStatusFlag::SpriteOverflow);
+                break;
+            }
             // record the index
             evaluatedSpriteIndices[evaluatedSpriteCount++] = i;
 
@@ -435,8 +464,8 @@ void PPU::evaluateSprites() {
         }
 
         // fetch the two pattern bytes
-        uint8_t lo = memory->ppuRead(addrLo);
-        uint8_t hi = memory->ppuRead(addrHi);
+        uint8_t lo = memory->chrRead(addrLo);
+        uint8_t hi = memory->chrRead(addrHi);
 
         // apply H‐flip if requested
         if (flipH) {
@@ -450,6 +479,13 @@ void PPU::evaluateSprites() {
         spriteXCounter[s] = xPos;
         spriteAttrs[s] = attr;
     }
+
+    // 4) clear the unused slots, so the pipeline state depends only on
+    //    this evaluation and not on how many dots drew the last one
+    for (int s = evaluatedSpriteCount; s < 8; ++s) {
+        spriteShiftLo[s] = spriteShiftHi[s] = 0;
+        spriteXCounter[s] = spriteAttrs[s] = 0;
+    }
 }
 
 void PPU::renderPixel() {
@@ -511,6 +547,17 @@ void PPU::renderPixel() {
         }
     }
 
+    // sprite‑0 hit: both non‑zero and sprite 0 is frontmost
+    if (sprite0HitPossible
+        && bgPixel != 0
+        && spritePixel != 0
+        && isSpriteZero
+        && x < 255)
+    {
+        flags.set(PPUStatusFlag::Sprite0Hit);
+    }
+    if (!pixelOutput) return;
+
     // === COMPOSITE ===
     uint8_t finalPixel = 0;
     uint8_t finalPalette = 0;
@@ -538,15 +585,6 @@ void PPU::renderPixel() {
             finalPixel = bgPixel;
             finalPalette = bgPalette;
         }
-        // sprite‑0 hit: both non‑zero and sprite 0 is frontmost
-        if (sprite0HitPossible
-            && bgPixel != 0
-            && spritePixel != 0
-            && isSpriteZero
-            && x < 255)
-        {
-            flags.set(PPUStatusFlag::Sprite0Hit);
-        }
     }
 
     // fetch color and write to frame buffer
@@ -576,13 +614,13 @@ void PPU::fetchBackgroundData() {
         case 4: {
             uint8_t fineY = (v >> 12) & 7;
             uint16_t base = (registers[0] & 0x10) ? 0x1000 : 0x0000;
-            nextTileLo = memory->ppuRead(base + nextTileID * 16 + fineY);
+            nextTileLo = memory->chrRead(base + nextTileID * 16 + fineY);
             break;
         }
         case 6: {
             uint8_t fineY = (v >> 12) & 7;
             uint16_t base = (registers[0] & 0x10) ? 0x1000 : 0x0000;
-            nextTileHi = memory->ppuRead(base + nextTileID * 16 + fineY + 8);
+            nextTileHi = memory->chrRead(base + nextTileID * 16 + fineY + 8);
             reloadBackgroundShifters();
             incrementX();
             break;
@@ -662,6 +700,9 @@ uint16_t PPU::mirrorAddress(uint16_t addr) const {
         case MirrorMode::SINGLE_SCREEN:
             pg = 0;
             break;
+        case MirrorMode::SINGLE_SCREEN_UPPER:
+            pg = 1;
+            break;
         }
         return 0x2000 + pg * 0x400 + idx;
     }
@@ -674,13 +715,13 @@ uint8_t PPU::vramRead(uint16_t addr) const {
     if (addr < 0x2000) {
         return memory->ppuRead(addr);
     }
-    // --- nametables ($2000–$2FFF) and palette ($3F00–$3F1F) live in vram[] ---
+    // --- nametables ($2000–$2FFF) and palette ($3F00–$3F1F) live in the PPU ---
     uint16_t m = mirrorAddress(addr);
     if (m < 0x3F00)
-        return vram[m];
+        return nametables[m - 0x2000];
     else
         // palette mirrors every 32 bytes
-        return vram[0x3F00 + (m & 0x1F)];
+        return palette[m & 0x1F];
 }
 
 void PPU::vramWrite(uint16_t addr, uint8_t val) {
@@ -693,9 +734,9 @@ void PPU::vramWrite(uint16_t addr, uint8_t val) {
     // --- name‐table / palette land in the PPU’s own RAM ---
     uint16_t m = mirrorAddress(addr);
     if (m < 0x3F00)
-        vram[m] = val;
+        nametables[m - 0x2000] = val;
     else
-        vram[0x3F00 + (m & 0x1F)] = val;
+        palette[m & 0x1F] = val;
 }
 
 uint8_t PPU::reverse_bits(uint8_t b) {
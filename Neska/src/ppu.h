@@ -6,6 +6,7 @@
 #include <iostream>
 #include "logger.h"
 #include "core.h"
+#include "savestate.h"
 
 struct PPUFlags {
     bool vblank = false;
@@ -26,7 +27,81 @@ class Memory;
 static const int SCREEN_WIDTH = 256;
 static const int SCREEN_HEIGHT = 240;
 
-class PPU {
+// Everything a snapshot of the PPU holds, as one plain block: the
+// registers and per-dot pipeline state packed into the first two cache
+// lines, then the RAMs. The snapshot is a single copy.
+struct alignas(64) PpuState {
+    // PPU cycle and scanline counters.
+    int cycle;    // 0 to 340 (or 339 on odd frames pre-render)
+    int scanline; // 0 to 261
+
+    // Sprite evaluation data
+    int evaluatedSpriteCount;          // Number of sprites on the current scanline (max 8)
+    int evaluatedSpriteIndices[8];     // OAM indices of the evaluated sprites.
+
+    // Mirroring mode.
+    MirrorMode mirrorMode;
+
+    // Loopy registers and internal variables.
+    uint16_t v;    // current VRAM address.
+    uint16_t t;    // temporary VRAM address.
+
+    // Background shift registers and latches.
+    uint16_t patternShiftLo;
+    uint16_t patternShiftHi;
+    uint16_t attribShiftLo;
+    uint16_t attribShiftHi;
+    uint8_t nextTileID;
+    uint8_t nextTileAttr;
+    uint8_t nextTileLo;
+    uint8_t nextTileHi;
+
+    uint8_t spriteShiftLo[8], spriteShiftHi[8];
+    uint8_t spriteXCounter[8], spriteAttrs[8];
+
+    // PPU registers (0-7, mirrored).
+    uint8_t registers[8];
+
+    uint8_t fineX; // fine horizontal scroll.
+    bool w;        // write toggle.
+
+    // Read buffer for PPUDATA.
+    uint8_t readBuffer;
+
+    // Scroll registers (set via PPUSCROLL writes).
+    uint8_t scrollX_coarse;
+    uint8_t scrollY_coarse;
+    uint8_t scrollY_fine;
+
+    PPUFlags flags;
+
+    bool vblankFlag;
+    bool vblankLatched;
+
+    // VBlank flag and NMI trigger.
+    bool nmiTriggered;
+
+    // Odd-frame flag (for even/odd frame timing).
+    bool oddFrame;
+
+    bool sprite0HitPossible;
+    bool sprite0HitFlag;
+    bool reloadPending;
+
+    // OAM memory (sprite RAM), 256 bytes, on its own cache line.
+    alignas(64) uint8_t oam[256];
+
+    uint8_t spriteScanline[32];
+
+    // Palette RAM ($3F00-$3F1F).
+    uint8_t palette[0x20];
+
+    // Nametable RAM: four 1 KB pages ($2000-$2FFF after mirrorAddress()).
+    // Only two exist on the board; the others serve four-screen carts.
+    uint8_t nametables[0x1000];
+};
+
+class PPU : private PpuState {
 public:
     // Constructor.
     explicit PPU(MirrorMode mode, Logger& logger);
@@ -39,8 +114,6 @@ public:
     // Update mirror mode.
     void setMirrorMode(MirrorMode mode);
 
-    void setCHR(uint8_t* chrData, size_t size);
-
     // CPU register read/write (0x2000-0x2007).
     uint8_t readRegister(uint16_t addr);
     void writeRegister(uint16_t addr, uint8_t value);
@@ -53,12 +126,28 @@ public:
     // Access the final 256x240 RGBA buffer.
     const uint32_t* getFrameBuffer() const;
 
-    // For sync
-    int getScanline() const { return scanline; }
-    int getCycle()    const { return cycle; }
-
-    // For debugging: get raw VRAM.
-    const uint8_t* getVRAM() const;
+    // With pixel output off the PPU skips pixel composition, palette
+    // lookups and framebuffer writes (the buffer keeps the last drawn
+    // frame). Everything a game can observe still runs: fetches and their
+    // mapper side effects, VRAM address updates, sprite evaluation and
+    // overflow, vblank/NMI, and sprite-0 hit on the lines where sprite 0
+    // is present. A setting of the front end, not machine state.
+    void setPixelOutput(bool enabled) { pixelOutput = enabled; }
+    bool pixelOutputEnabled() const { return pixelOutput; }
+
+    // For sync: the next dot to run, and the parity of the current frame
+    // (odd frames skip a dot when rendering is on).
+    int  getScanline() const { return scanline; }
+    int  getCycle()    const { return cycle; }
+    bool isOddFrame()  const { return oddFrame; }
+
+    // Clock the mapper's scanline counter if A12 rose at 'dot' (260 or
+    // 324) of the current line.
+    void clockScanlineCounter(int dot);
+
+    // For debugging: raw nametable RAM (four 1 KB pages) and palette RAM.
+    const uint8_t* getNametables() const { return nametables; }
+    const uint8_t* getPalette() const { return palette; }
 
     // NMI: triggered when entering VBlank.
     bool isNmiTriggered() const;
@@ -66,6 +155,7 @@ public:
 
     // CPU OAM DMA writes.
     void writeOAM(uint8_t data);
+    void writeOAMPage(const uint8_t* data);  // all 256 bytes from OAMADDR
 
     // For the NES palette.
     static const uint32_t nesPalette[64];
@@ -82,6 +172,11 @@ public:
     bool isVBlank() const;
     bool nmiOutputEnabled() const;
     void clearVBlank();
+
+    // Snapshot support: the PpuState block. The framebuffer is output, not
+    // state, and is skipped.
+    void saveState(StateWriter& w) const;
+    void loadState(StateReader& r);
 private:
     // Background pipeline functions.
     void fetchBackgroundData();
@@ -94,77 +189,17 @@ private:
     void renderPixel();
 
     void evaluateSprites();
+    int  a12RiseDot() const;  // dot of the per-line A12 rise, 0 if none
 private:
     Logger* logger;
 
-    bool vblankFlag;
-    bool vblankLatched;
-
-    // PPU registers (0-7, mirrored).
-    uint8_t registers[8];
-
-    // VRAM (pattern tables, name tables, palette).
-    uint8_t vram[0x4000];
-
-    // OAM memory (sprite RAM), 256 bytes.
-    uint8_t oam[256];
-
-    // Final output: 256x240 ARGB.
-    uint32_t frameBuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
-
-    // Loopy registers and internal variables.
-    uint16_t v;    // current VRAM address.
-    uint16_t t;    // temporary VRAM address.
-    uint8_t fineX; // fine horizontal scroll.
-    bool w;        // write toggle.
-
-    // Read buffer for PPUDATA.
-    uint8_t readBuffer;
-
-    // PPU cycle and scanline counters.
-    int cycle;    // 0 to 340 (or 339 on odd frames pre-render)
-    int scanline; // 0 to 261
-
-    // VBlank flag and NMI trigger.
-    bool nmiTriggered;
-
-    // Odd-frame flag (for even/odd frame timing).
-    bool oddFrame;
-
-    // Mirroring mode.
-    MirrorMode mirrorMode;
-
-    PPUFlags flags;
-
     // Pointer to Memory (for mapper and CHR data).
     Memory* memory;
 
-    // Background shift registers and latches.
-    uint16_t patternShiftLo;
-    uint16_t patternShiftHi;
-    uint16_t attribShiftLo;
-    uint16_t attribShiftHi;
-    uint8_t nextTileID;
-    uint8_t nextTileAttr;
-    uint8_t nextTileLo;
-    uint8_t nextTileHi;
+    // Final output: 256x240 ARGB, kept off the state block.
+    std::vector<uint32_t> frameBuffer;
 
-    uint8_t spriteShiftLo[8], spriteShiftHi[8];
-    uint8_t spriteXCounter[8], spriteAttrs[8];
-    bool    sprite0HitPossible;
+    bool pixelOutput;
 
     uint8_t reverse_bits(uint8_t b);
-
-    // Scroll registers (set via PPUSCROLL writes).
-    uint8_t scrollX_coarse;
-    uint8_t scrollY_coarse;
-    uint8_t scrollY_fine;
-
-    // *** NEW: Sprite evaluation data ***
-    int evaluatedSpriteCount;          // Number of sprites on the current scanline (max 8)
-    int evaluatedSpriteIndices[8];     // OAM indices of the evaluated sprites.            // Flag for sprite 0 hit on the current scanline.
-    uint8_t spriteScanline[32]{};
-    bool sprite0HitFlag;
-
-    bool reloadPending;
 };
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include "Renderer.h"
+#include "latency.h"
+#include "liveinput.h"
 #include <iostream>
 #include <cassert>
 
 Renderer::Renderer(int w, int h, const std::string& title)
     : window(nullptr), sdlRenderer(nullptr), texture(nullptr),
-    width(w), height(h)
+    width(w), height(h), screenshotRequested(false),
+    saveStateRequested(false), loadStateRequested(false), rewindKeyDown(false),
+    latency(nullptr), liveInput(nullptr)
 {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL init error:" << SDL_GetError() << "\n";
@@ -47,7 +51,28 @@ void Renderer::renderFrame(const uint32_t* pixels)
     SDL_UpdateTexture(texture, nullptr, pixels, width * sizeof(uint32_t));
     SDL_RenderClear(sdlRenderer);
     SDL_RenderTexture(sdlRenderer, texture, nullptr, nullptr);
+    if (latency) latency->presentBegin();
     SDL_RenderPresent(sdlRenderer);
+    if (latency) latency->presentEnd();
+}
+
+void Renderer::setButton(Memory& memory, int bit, bool pressed, const SDL_KeyboardEvent& key)
+{
+    uint8_t state = liveInput ? liveInput->state() : memory.getControllerState();
+    if (latency && !key.repeat && ((state >> bit) & 1) != (pressed ? 1 : 0)) {
+        // The event was queued before this poll: back-date it by its age
+        // on SDL's clock
+        uint64_t ticks = SDL_GetTicksNS();
+        uint64_t age = key.timestamp < ticks ? ticks - key.timestamp : 0;
+        latency->inputEvent(bit, pressed,
+            LatencyTracker::Clock::now() - std::chrono::nanoseconds(age));
+    }
+    if (liveInput) {
+        if (pressed) liveInput->press(bit);
+        else liveInput->release(bit);
+    }
+    else if (pressed) memory.setButtonPressed(bit);
+    else memory.clearButtonPressed(bit);
 }
 
 bool Renderer::pollEvents(Memory& memory)
@@ -59,27 +84,32 @@ bool Renderer::pollEvents(Memory& memory)
         }
         else if (e.type == SDL_EVENT_KEY_DOWN) {
             switch (e.key.scancode) {
-            case SDL_SCANCODE_Z: memory.setButtonPressed(0); break;
-            case SDL_SCANCODE_X: memory.setButtonPressed(1); break;
-            case SDL_SCANCODE_RETURN: memory.setButtonPressed(3); break;
-            case SDL_SCANCODE_RSHIFT: memory.setButtonPressed(2); break;
-            case SDL_SCANCODE_UP: memory.setButtonPressed(4); break;
-            case SDL_SCANCODE_DOWN: memory.setButtonPressed(5); break;
-            case SDL_SCANCODE_LEFT: memory.setButtonPressed(6); break;
-            case SDL_SCANCODE_RIGHT: memory.setButtonPressed(7); break;
+            case SDL_SCANCODE_Z: setButton(memory, 0, true, e.key); break;
+            case SDL_SCANCODE_X: setButton(memory, 1, true, e.key); break;
+            case SDL_SCANCODE_RETURN: setButton(memory, 3, true, e.key); break;
+            case SDL_SCANCODE_RSHIFT: setButton(memory, 2, true, e.key); break;
+            case SDL_SCANCODE_UP: setButton(memory, 4, true, e.key); break;
+            case SDL_SCANCODE_DOWN: setButton(memory, 5, true, e.key); break;
+            case SDL_SCANCODE_LEFT: setButton(memory, 6, true, e.key); break;
+            case SDL_SCANCODE_RIGHT: setButton(memory, 7, true, e.key); break;
+            case SDL_SCANCODE_BACKSPACE: rewindKeyDown = true; break;
+            case SDL_SCANCODE_F5: saveStateRequested = true; break;
+            case SDL_SCANCODE_F7: loadStateRequested = true; break;
+            case SDL_SCANCODE_F12: screenshotRequested = true; break;
             default: break;
             }
         }
         else if (e.type == SDL_EVENT_KEY_UP) {
             switch (e.key.scancode) {
-            case SDL_SCANCODE_Z: memory.clearButtonPressed(0); break;
-            case SDL_SCANCODE_X: memory.clearButtonPressed(1); break;
-            case SDL_SCANCODE_RETURN: memory.clearButtonPressed(3); break;
-            case SDL_SCANCODE_RSHIFT: memory.clearButtonPressed(2); break;
-            case SDL_SCANCODE_UP: memory.clearButtonPressed(4); break;
-            case SDL_SCANCODE_DOWN: memory.clearButtonPressed(5); break;
-            case SDL_SCANCODE_LEFT: memory.clearButtonPressed(6); break;
-            case SDL_SCANCODE_RIGHT: memory.clearButtonPressed(7); break;
+            case SDL_SCANCODE_Z: setButton(memory, 0, false, e.key); break;
+            case SDL_SCANCODE_X: setButton(memory, 1, false, e.key); break;
+            case SDL_SCANCODE_RETURN: setButton(memory, 3, false, e.key); break;
+            case SDL_SCANCODE_RSHIFT: setButton(memory, 2, false, e.key); break;
+            case SDL_SCANCODE_UP: setButton(memory, 4, false, e.key); break;
+            case SDL_SCANCODE_DOWN: setButton(memory, 5, false, e.key); break;
+            case SDL_SCANCODE_LEFT: setButton(memory, 6, false, e.key); break;
+            case SDL_SCANCODE_RIGHT: setButton(memory, 7, false, e.key); break;
+            case SDL_SCANCODE_BACKSPACE: rewindKeyDown = false; break;
             default: break;
             }
         }
@@ -87,6 +117,27 @@ bool Renderer::pollEvents(Memory& memory)
     return true;
 }
 
+bool Renderer::takeScreenshotRequest()
+{
+    bool requested = screenshotRequested;
+    screenshotRequested = false;
+    return requested;
+}
+
+bool Renderer::takeSaveStateRequest()
+{
+    bool requested = saveStateRequested;
+    saveStateRequested = false;
+    return requested;
+}
+
+bool Renderer::takeLoadStateRequest()
+{
+    bool requested = loadStateRequested;
+    loadStateRequested = false;
+    return requested;
+}
+
 std::vector<uint32_t> Renderer::upscaleImage(const uint32_t* source, int sw, int sh, int scale)
 {
     int dw = sw * scale;
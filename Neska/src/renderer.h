@@ -5,6 +5,9 @@
 #include <string>
 #include "memory.h"
 
+class LatencyTracker;
+class LiveInput;
+
 class Renderer {
 public:
     Renderer(int w, int h, const std::string& title);
@@ -13,6 +16,24 @@ public:
     void renderFrame(const uint32_t* pixels);
     bool pollEvents(Memory& memory);
 
+    // True once after F12 was pressed.
+    bool takeScreenshotRequest();
+
+    // True once after F5 (quick save) / F7 (quick load) was pressed.
+    bool takeSaveStateRequest();
+    bool takeLoadStateRequest();
+
+    // True while Backspace (rewind) is held down.
+    bool rewindHeld() const { return rewindKeyDown; }
+
+    // Timestamp controller key events and bracket SDL_RenderPresent for
+    // 'tracker'; null to stop.
+    void setLatencyTracker(LatencyTracker* tracker) { latency = tracker; }
+
+    // Send controller keys to 'input' instead of Memory, for polling
+    // while another thread emulates; null to go back.
+    void setLiveInput(LiveInput* input) { liveInput = input; }
+
     std::vector<uint32_t> upscaleImage(const uint32_t* source, int sw, int sh, int scale);
 
 private:
@@ -20,4 +41,12 @@ private:
     SDL_Renderer* sdlRenderer;
     SDL_Texture* texture;
     int width, height;
+    bool screenshotRequested;
+    bool saveStateRequested;
+    bool loadStateRequested;
+    bool rewindKeyDown;
+    LatencyTracker* latency;
+    LiveInput* liveInput;
+
+    void setButton(Memory& memory, int bit, bool pressed, const SDL_KeyboardEvent& key);
 };
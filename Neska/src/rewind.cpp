@@ -0,0 +1,250 @@
+// rewind.cpp
+#include "rewind.h"
+#include "machine.h"
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+// Zero-run coding of (state XOR reference)
+//
+// The stream is a sequence of tokens: varint zeroRun, varint literalLength,
+// literal bytes. A literal run only ends at four or more zero bytes, so
+// isolated zeros inside changed data don't fragment it into tiny tokens.
+// ----------------------------------------------------------------------------
+
+static uint8_t* putVarint(uint8_t* out, size_t v) {
+    while (v >= 0x80) {
+        *out++ = uint8_t(v) | 0x80;
+        v >>= 7;
+    }
+    *out++ = uint8_t(v);
+    return out;
+}
+
+static bool getVarint(const uint8_t*& in, const uint8_t* end, size_t& v) {
+    v = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t b = *in++;
+        v |= size_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Worst case is one literal token covering everything.
+static size_t maxEncodedSize(size_t n) {
+    return n + 2 * 10;
+}
+
+// 'ref' may be null, in which case 'src' itself is coded (keyframes).
+static size_t encodeRuns(const uint8_t* src, const uint8_t* ref, size_t n, uint8_t* out) {
+    auto diff = [&](size_t i) -> uint8_t { return ref ? uint8_t(src[i] ^ ref[i]) : src[i]; };
+
+    uint8_t* o = out;
+    size_t i = 0;
+    while (i < n) {
+        // Zero run, eight bytes at a time while possible
+        size_t zeroStart = i;
+        while (i + 8 <= n) {
+            uint64_t a, b = 0;
+            std::memcpy(&a, src + i, 8);
+            if (ref) std::memcpy(&b, ref + i, 8);
+            if (a != b) break;
+            i += 8;
+        }
+        while (i < n && diff(i) == 0) i++;
+        size_t zeros = i - zeroStart;
+
+        // Literal run up to the next stretch of at least four zeros
+        size_t litStart = i;
+        while (i < n) {
+            if (diff(i) == 0 && i + 4 <= n &&
+                diff(i + 1) == 0 && diff(i + 2) == 0 && diff(i + 3) == 0) {
+                break;
+            }
+            i++;
+        }
+        size_t literals = i - litStart;
+
+        o = putVarint(o, zeros);
+        o = putVarint(o, literals);
+        for (size_t k = litStart; k < i; ++k) {
+            *o++ = diff(k);
+        }
+    }
+    return size_t(o - out);
+}
+
+// With 'applyXor' the literals are XORed into 'dst' and zero runs leave it
+// untouched; otherwise the stream is expanded as-is.
+static bool decodeRuns(const uint8_t* in, size_t size, uint8_t* dst, size_t n, bool applyXor) {
+    const uint8_t* end = in + size;
+    size_t pos = 0;
+    while (in < end) {
+        size_t zeros, literals;
+        if (!getVarint(in, end, zeros) || !getVarint(in, end, literals)) return false;
+        if (zeros > n - pos || literals > n - pos - zeros ||
+            literals > size_t(end - in)) {
+            return false;
+        }
+        if (!applyXor) std::memset(dst + pos, 0, zeros);
+        pos += zeros;
+        if (applyXor) {
+            for (size_t k = 0; k < literals; ++k) dst[pos + k] ^= in[k];
+        }
+        else {
+            std::memcpy(dst + pos, in, literals);
+        }
+        pos += literals;
+        in += literals;
+    }
+    return pos == n;
+}
+
+// ----------------------------------------------------------------------------
+// RewindBuffer
+// ----------------------------------------------------------------------------
+
+RewindBuffer::RewindBuffer(size_t capacityBytes, unsigned keyframeInterval)
+    : arena(capacityBytes),
+    writePos(0),
+    bytesUsed(0),
+    evicted(0),
+    keyframeInterval(keyframeInterval ? keyframeInterval : 1),
+    sinceKeyframe(0),
+    keyframeValid(false),
+    stateSize(0)
+{
+}
+
+void RewindBuffer::clear() {
+    entries.clear();
+    writePos = 0;
+    bytesUsed = 0;
+    sinceKeyframe = 0;
+    keyframeValid = false;
+}
+
+bool RewindBuffer::push(const Machine& machine) {
+    size_t n = machine.stateSize();
+    if (n != stateSize) {
+        // A different cartridge: old snapshots no longer apply
+        clear();
+        stateSize = n;
+        current.resize(n);
+        keyState.resize(n);
+        packed.resize(maxEncodedSize(n));
+    }
+    if (!machine.saveState(current.data(), n)) return false;
+
+    for (;;) {
+        bool key = !keyframeValid || sinceKeyframe + 1 >= keyframeInterval;
+        size_t len = encodeRuns(current.data(), key ? nullptr : keyState.data(), n, packed.data());
+
+        uint8_t* dst = allocate(len);
+        if (!dst) return false;
+        // Making room may have evicted the keyframe this delta refers to
+        if (!key && !keyframeValid) continue;
+
+        std::memcpy(dst, packed.data(), len);
+        entries.push_back({ size_t(dst - arena.data()), len, key });
+        writePos = entries.back().offset + len;
+        bytesUsed += len;
+
+        if (key) {
+            keyState.swap(current);
+            keyframeValid = true;
+            sinceKeyframe = 0;
+        }
+        else {
+            sinceKeyframe++;
+        }
+        return true;
+    }
+}
+
+bool RewindBuffer::rewind(Machine& machine) {
+    if (entries.empty()) return false;
+
+    const Entry& entry = entries.back();
+    const Entry* keyframe = nullptr;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->keyframe) {
+            keyframe = &*it;
+            break;
+        }
+    }
+
+    bool ok = keyframe && decodeEntry(entry, *keyframe) &&
+        machine.loadState(current.data(), stateSize);
+
+    // The entry is the newest allocation, so its space is reclaimed directly
+    bytesUsed -= entry.size;
+    writePos = entry.offset;
+    if (entry.keyframe) {
+        keyframeValid = false;
+    }
+    else if (sinceKeyframe > 0) {
+        sinceKeyframe--;
+    }
+    entries.pop_back();
+    if (entries.empty()) clear();
+    return ok;
+}
+
+bool RewindBuffer::decodeEntry(const Entry& entry, const Entry& keyframe) {
+    if (!decodeRuns(arena.data() + keyframe.offset, keyframe.size,
+        current.data(), stateSize, false)) {
+        return false;
+    }
+    if (&entry == &keyframe) return true;
+    return decodeRuns(arena.data() + entry.offset, entry.size,
+        current.data(), stateSize, true);
+}
+
+uint8_t* RewindBuffer::allocate(size_t size) {
+    if (size > arena.size()) return nullptr;
+    for (;;) {
+        if (entries.empty()) {
+            writePos = 0;
+            return arena.data();
+        }
+        size_t head = entries.front().offset;
+        if (writePos > head) {
+            // Live data is [head, writePos): free space at the end, then at the start
+            if (arena.size() - writePos >= size) return arena.data() + writePos;
+            if (head >= size) {
+                writePos = 0;
+                return arena.data();
+            }
+        }
+        else if (head - writePos >= size) {
+            // Wrapped: free space is [writePos, head)
+            return arena.data() + writePos;
+        }
+        evictOldestGroup();
+    }
+}
+
+void RewindBuffer::evictOldestGroup() {
+    // A keyframe and all the deltas that depend on it leave together
+    do {
+        bytesUsed -= entries.front().size;
+        entries.pop_front();
+        evicted++;
+    } while (!entries.empty() && !entries.front().keyframe);
+
+    if (entries.empty()) {
+        writePos = 0;
+        keyframeValid = false;
+    }
+}
+
+RewindStats RewindBuffer::stats() const {
+    RewindStats s;
+    s.entries = entries.size();
+    s.bytesUsed = bytesUsed;
+    s.capacity = arena.size();
+    s.stateSize = stateSize;
+    s.evicted = evicted;
+    return s;
+}
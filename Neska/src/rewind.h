@@ -0,0 +1,75 @@
+// rewind.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class Machine;
+
+struct RewindStats {
+    size_t entries = 0;        // snapshots currently held
+    size_t bytesUsed = 0;      // compressed bytes in the arena
+    size_t capacity = 0;       // arena size
+    size_t stateSize = 0;      // uncompressed size of one snapshot
+    uint64_t evicted = 0;      // snapshots dropped to make room
+};
+
+// Fixed-memory history of machine snapshots for interactive rewind.
+//
+// Every pushed state goes into one preallocated byte arena used as a ring.
+// Every 'keyframeInterval' entries a keyframe is stored; the entries in
+// between are XOR deltas against that keyframe. Both are run-length coded
+// (zero runs + literals), which is what XOR deltas of mostly-unchanged
+// state compress best with. Restoring any entry therefore decodes one
+// keyframe and at most one delta. When the arena is full the oldest
+// keyframe is dropped together with its deltas.
+class RewindBuffer {
+public:
+    explicit RewindBuffer(size_t capacityBytes = 16 * 1024 * 1024,
+        unsigned keyframeInterval = 60);
+
+    RewindBuffer(const RewindBuffer&) = delete;
+    RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+    // Capture the machine's current state. Call once per frame, before
+    // running it. Returns false if one snapshot does not fit the arena.
+    bool push(const Machine& machine);
+
+    // Restore the newest snapshot into 'machine' and drop it from the ring.
+    // Returns false when the history is empty.
+    bool rewind(Machine& machine);
+
+    void clear();
+
+    bool   empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+    RewindStats stats() const;
+
+private:
+    struct Entry {
+        size_t offset;   // position in the arena
+        size_t size;     // compressed size
+        bool   keyframe;
+    };
+
+    uint8_t* allocate(size_t size);
+    void     evictOldestGroup();
+    bool     decodeEntry(const Entry& entry, const Entry& keyframe);
+
+    std::vector<uint8_t> arena;
+    std::deque<Entry>    entries;
+    size_t   writePos;
+    size_t   bytesUsed;
+    uint64_t evicted;
+
+    unsigned keyframeInterval;
+    unsigned sinceKeyframe;    // deltas pushed since the newest keyframe
+    bool     keyframeValid;    // keyState matches the newest keyframe entry
+
+    size_t               stateSize;
+    std::vector<uint8_t> current;   // scratch: freshly saved/decoded state
+    std::vector<uint8_t> keyState;  // raw copy of the newest keyframe
+    std::vector<uint8_t> packed;    // scratch: compressed output
+};
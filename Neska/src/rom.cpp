@@ -0,0 +1,163 @@
+// rom.cpp
+#include "rom.h"
+#include "checksum.h"
+#include "romdb.h"
+
+#include <algorithm>
+#include <iostream>
+
+// NES 2.0 ROM size: 12-bit unit count, or exponent-multiplier form when
+// the MSB nibble is $F. Returns false if the size does not fit 32 bits.
+static bool romAreaSize(uint8_t lsb, uint8_t msb, uint32_t unit, uint32_t& out) {
+    if (msb == 0x0F) {
+        int exponent = lsb >> 2;
+        uint32_t multiplier = (lsb & 3) * 2 + 1;
+        if (exponent > 28) return false;
+        out = (uint32_t(1) << exponent) * multiplier;
+        return true;
+    }
+    out = ((uint32_t(msb) << 8) | lsb) * unit;
+    return true;
+}
+
+// RAM sizes are stored as shift counts: 64 << n bytes, 0 = none.
+static uint32_t ramSize(uint8_t shift) {
+    return shift ? uint32_t(64) << shift : 0;
+}
+
+bool parseRomHeader(const uint8_t* data, size_t size, RomHeader& h) {
+    if (!data || size < 16) {
+        std::cerr << "File too small for iNES header.\n";
+        return false;
+    }
+
+    // Validate iNES signature "NES" 0x1A
+    if (!(data[0] == 'N' && data[1] == 'E' && data[2] == 'S' && data[3] == 0x1A)) {
+        std::cerr << "Not a valid iNES ROM.\n";
+        return false;
+    }
+
+    h = RomHeader();
+    uint8_t flags6 = data[6];
+    uint8_t flags7 = data[7];
+    h.nes2 = ((flags7 & 0x0C) == 0x08);
+
+    h.battery = (flags6 & 0x02) != 0;
+    h.trainer = (flags6 & 0x04) != 0;
+    if (flags6 & 0x08) {
+        h.mirror = MirrorMode::FOUR_SCREEN;
+    }
+    else {
+        bool vert = (flags6 & 0x01) != 0;
+        h.mirror = vert ? MirrorMode::VERTICAL : MirrorMode::HORIZONTAL;
+    }
+    h.consoleType = flags7 & 0x03;
+
+    uint8_t mapperLow = (flags6 >> 4) & 0x0F;
+    uint8_t mapperHigh = flags7 & 0xF0;
+
+    if (h.nes2) {
+        h.mapperID = uint16_t(mapperHigh | mapperLow | ((data[8] & 0x0F) << 8));
+        h.submapper = data[8] >> 4;
+        if (!romAreaSize(data[4], data[9] & 0x0F, 0x4000, h.prgSize) ||
+            !romAreaSize(data[5], data[9] >> 4, 0x2000, h.chrSize)) {
+            std::cerr << "Unsupported NES 2.0 ROM size.\n";
+            return false;
+        }
+        h.prgRamSize = ramSize(data[10] & 0x0F);
+        h.prgNvramSize = ramSize(data[10] >> 4);
+        h.chrRamSize = ramSize(data[11] & 0x0F);
+        h.chrNvramSize = ramSize(data[11] >> 4);
+        h.timing = RomTiming(data[12] & 0x03);
+    }
+    else {
+        // Old dumps carry text ("DiskDude!") in bytes 7-15; the high
+        // mapper nibble is garbage when the padding is not zero.
+        bool dirty = (data[12] | data[13] | data[14] | data[15]) != 0;
+        h.mapperID = uint16_t((dirty ? 0 : mapperHigh) | mapperLow);
+        h.prgSize = uint32_t(data[4]) * 0x4000;
+        h.chrSize = uint32_t(data[5]) * 0x2000;
+        uint32_t ram = uint32_t(data[8] ? data[8] : 1) * 0x2000;
+        if (h.battery) {
+            h.prgNvramSize = ram;
+            h.prgRamSize = 0;
+        }
+        else {
+            h.prgRamSize = ram;
+        }
+        h.chrRamSize = h.chrSize ? 0 : 0x2000;
+        if (!dirty && (data[9] & 0x01)) h.timing = RomTiming::PAL;
+    }
+    return true;
+}
+
+// Parse the header at 'data' and point rom.prg/rom.chr into it. 'data'
+// must outlive the image unless copyData is set; short files are always
+// copied so the missing bytes can read as zero.
+static bool parseInto(RomImage& rom, const uint8_t* data, size_t size, bool copyData) {
+    if (!parseRomHeader(data, size, rom.header)) return false;
+
+    const size_t headerSize = 16;
+    size_t trainerSize = rom.header.trainer ? 512 : 0;
+    size_t prgSize = rom.header.prgSize;
+    size_t chrSize = rom.header.chrSize;
+    size_t prgOffset = headerSize + trainerSize;
+    size_t chrOffset = prgOffset + prgSize;
+
+    bool truncated = size < prgOffset + prgSize + chrSize;
+    if (truncated) {
+        std::cerr << "ROM file seems truncated.\n";
+        // still initialize what we can
+    }
+
+    if (copyData || truncated) {
+        // PRG and CHR are contiguous in the file; missing bytes read as zero
+        rom.copy.assign(prgSize + chrSize, 0);
+        if (prgOffset < size) {
+            size_t avail = std::min(prgSize + chrSize, size - prgOffset);
+            std::copy_n(data + prgOffset, avail, rom.copy.begin());
+        }
+        rom.prg = { rom.copy.data(), prgSize };
+        rom.chr = { rom.copy.data() + prgSize, chrSize };
+    }
+    else {
+        rom.prg = { data + prgOffset, prgSize };
+        rom.chr = { data + chrOffset, chrSize };
+    }
+
+    rom.hash = crc32(rom.prg.data, rom.prg.size);
+    rom.hash = crc32(rom.chr.data, rom.chr.size, rom.hash);
+    return true;
+}
+
+// Replace the file's header with the catalog's for the same PRG+CHR.
+static void applyCatalog(RomImage& rom, const RomCatalog& catalog) {
+    uint64_t xxh = xxhash64(rom.prg.data, rom.prg.size + rom.chr.size);  // contiguous
+    const CatalogEntry* e = catalog.find(rom.hash, xxh);
+    if (!e) return;
+
+    RomHeader known = catalogHeader(*e);
+    if (known.prgSize != rom.header.prgSize || known.chrSize != rom.header.chrSize) return;
+    if (known.mapperID != rom.header.mapperID || known.mirror != rom.header.mirror) {
+        std::cerr << "Header corrected from catalog: mapper " << rom.header.mapperID
+            << " -> " << known.mapperID << "." << int(known.submapper) << "\n";
+    }
+    known.trainer = rom.header.trainer;  // describes this file's layout
+    rom.header = known;
+}
+
+std::shared_ptr<const RomImage> loadRomImage(const std::string& filename,
+    const RomCatalog* catalog) {
+    auto rom = std::make_shared<RomImage>();
+    if (!rom->file.open(filename)) return nullptr;
+    if (!parseInto(*rom, rom->file.data(), rom->file.size(), false)) return nullptr;
+    if (!rom->copy.empty()) rom->file.close();  // truncated: the copy is all we use
+    if (catalog) applyCatalog(*rom, *catalog);
+    return rom;
+}
+
+std::shared_ptr<const RomImage> parseRomImage(const uint8_t* data, size_t size) {
+    auto rom = std::make_shared<RomImage>();
+    if (!parseInto(*rom, data, size, true)) return nullptr;
+    return rom;
+}
@@ -0,0 +1,77 @@
+// rom.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "core.h"
+#include "mappedfile.h"
+
+// A read-only run of bytes inside a RomImage.
+struct RomSpan {
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+
+    bool empty() const { return size == 0; }
+};
+
+enum class RomTiming : uint8_t {
+    NTSC,
+    PAL,
+    Multi,   // runs on either
+    Dendy
+};
+
+// Everything an iNES or NES 2.0 header says about the cartridge. iNES 1
+// headers leave most of it implied; the defaults below are what an iNES 1
+// cartridge is assumed to have.
+struct RomHeader {
+    bool       nes2 = false;
+    uint16_t   mapperID = 0;      // 12 bits in NES 2.0
+    uint8_t    submapper = 0;
+    MirrorMode mirror = MirrorMode::HORIZONTAL;
+    bool       battery = false;   // PRG-NVRAM (or other memory) is battery-backed
+    bool       trainer = false;   // 512 bytes between header and PRG
+    uint32_t   prgSize = 0;       // bytes
+    uint32_t   chrSize = 0;       // bytes, 0 = CHR-RAM
+    uint32_t   prgRamSize = 0x2000;
+    uint32_t   prgNvramSize = 0;
+    uint32_t   chrRamSize = 0;    // 8 KB implied by iNES 1 when chrSize is 0
+    uint32_t   chrNvramSize = 0;
+    RomTiming  timing = RomTiming::NTSC;
+    uint8_t    consoleType = 0;   // 0 NES/Famicom, 1 Vs. System, 2 PlayChoice-10, 3 extended
+};
+
+// Parse the 16-byte header at 'data'. Prints why and returns false if it
+// is not an iNES file.
+bool parseRomHeader(const uint8_t* data, size_t size, RomHeader& out);
+
+class RomCatalog;
+
+// A parsed iNES image. Immutable once loaded, so one image can back any
+// number of machines running the same game on different threads. Mappers
+// read PRG and CHR in place and hold a reference to the image, so ROM
+// bytes are never copied per machine.
+struct RomImage {
+    RomHeader header;
+
+    RomSpan prg;
+    RomSpan chr;               // follows prg directly; empty with CHR-RAM
+
+    uint32_t hash = 0;         // CRC-32 of PRG+CHR (header excluded)
+
+    // Backing store for prg/chr: the mapped file, or a private copy for
+    // images parsed from memory and for truncated files (padded with 0).
+    MappedFile           file;
+    std::vector<uint8_t> copy;
+};
+
+// Map and parse an iNES file. Returns nullptr (after printing why) on
+// failure. With a catalog, a known image (matched by PRG+CHR hash) takes
+// its header from the catalog, which corrects bad or iNES 1 headers.
+std::shared_ptr<const RomImage> loadRomImage(const std::string& path,
+    const RomCatalog* catalog = nullptr);
+
+// Parse an iNES image already in memory. PRG and CHR are copied.
+std::shared_ptr<const RomImage> parseRomImage(const uint8_t* data, size_t size);
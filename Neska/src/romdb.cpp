@@ -0,0 +1,281 @@
+// romdb.cpp
+#include "romdb.h"
+#include "checksum.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static const uint16_t CATALOG_VERSION = 1;
+
+struct CatalogHeader {
+    char     magic[4];       // "NKDB"
+    uint16_t version;
+    uint16_t entrySize;
+    uint32_t count;
+    uint32_t stringsSize;
+};
+static_assert(sizeof(CatalogHeader) == 16, "CatalogHeader is a file format");
+
+// ===========================
+// Entries
+// ===========================
+CatalogEntry makeCatalogEntry(const RomHeader& h, uint32_t crc, uint64_t xxhash) {
+    CatalogEntry e = {};
+    e.crc32 = crc;
+    e.xxhash = xxhash;
+    e.prgSize = h.prgSize;
+    e.chrSize = h.chrSize;
+    e.prgRamSize = h.prgRamSize;
+    e.prgNvramSize = h.prgNvramSize;
+    e.chrRamSize = h.chrRamSize;
+    e.chrNvramSize = h.chrNvramSize;
+    e.mapperID = h.mapperID;
+    e.submapper = h.submapper;
+    e.mirror = uint8_t(h.mirror);
+    e.timing = uint8_t(h.timing);
+    e.consoleType = h.consoleType;
+    e.flags = (h.nes2 ? CATALOG_NES2 : 0) | (h.battery ? CATALOG_BATTERY : 0) |
+        (h.trainer ? CATALOG_TRAINER : 0);
+    return e;
+}
+
+RomHeader catalogHeader(const CatalogEntry& e) {
+    RomHeader h;
+    h.nes2 = (e.flags & CATALOG_NES2) != 0;
+    h.battery = (e.flags & CATALOG_BATTERY) != 0;
+    h.trainer = (e.flags & CATALOG_TRAINER) != 0;
+    h.mapperID = e.mapperID;
+    h.submapper = e.submapper;
+    h.mirror = MirrorMode(e.mirror);
+    h.prgSize = e.prgSize;
+    h.chrSize = e.chrSize;
+    h.prgRamSize = e.prgRamSize;
+    h.prgNvramSize = e.prgNvramSize;
+    h.chrRamSize = e.chrRamSize;
+    h.chrNvramSize = e.chrNvramSize;
+    h.timing = RomTiming(e.timing);
+    h.consoleType = e.consoleType;
+    return h;
+}
+
+static bool entryLess(const CatalogEntry& a, const CatalogEntry& b) {
+    if (a.crc32 != b.crc32) return a.crc32 < b.crc32;
+    return a.xxhash < b.xxhash;
+}
+
+// ===========================
+// Library scan
+// ===========================
+static bool isRomFile(const fs::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+        [](unsigned char c) { return char(std::tolower(c)); });
+    return ext == ".nes";
+}
+
+static bool scanFile(const std::string& path, ScannedRom& out) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    RomHeader header;
+    if (!parseRomHeader(file.data(), file.size(), header)) {
+        std::cerr << "Skipping " << path << "\n";
+        return false;
+    }
+    size_t offset = 16 + (header.trainer ? 512 : 0);
+    size_t length = size_t(header.prgSize) + header.chrSize;
+    if (file.size() < offset + length) {
+        std::cerr << "Skipping truncated " << path << "\n";
+        return false;
+    }
+
+    const uint8_t* content = file.data() + offset;
+    out.path = path;
+    out.entry = makeCatalogEntry(header, crc32(content, length), xxhash64(content, length));
+    return true;
+}
+
+std::vector<ScannedRom> scanRomLibrary(const std::vector<std::string>& roots, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    struct Work {
+        fs::path path;
+        bool     directory;
+    };
+    std::vector<Work>       queue;
+    std::mutex              queueMutex;
+    std::condition_variable queueChanged;
+    unsigned                busy = 0;
+    std::vector<ScannedRom> results;
+
+    for (const auto& root : roots) {
+        std::error_code ec;
+        queue.push_back({ fs::path(root), fs::is_directory(root, ec) });
+    }
+
+    auto worker = [&] {
+        std::vector<ScannedRom> local;
+        std::vector<Work> found;
+        for (;;) {
+            Work item;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [&] { return !queue.empty() || busy == 0; });
+                if (queue.empty()) break;  // nothing queued and nobody can add more
+                item = std::move(queue.back());
+                queue.pop_back();
+                ++busy;
+            }
+
+            found.clear();
+            if (item.directory) {
+                std::error_code ec;
+                fs::directory_iterator it(item.path, fs::directory_options::skip_permission_denied, ec);
+                for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                    std::error_code typeError;
+                    if (it->is_directory(typeError)) {
+                        found.push_back({ it->path(), true });
+                    }
+                    else if (it->is_regular_file(typeError) && isRomFile(it->path())) {
+                        found.push_back({ it->path(), false });
+                    }
+                }
+                if (ec) std::cerr << "Cannot list " << item.path.string() << ": " << ec.message() << "\n";
+            }
+            else {
+                ScannedRom rom;
+                if (scanFile(item.path.string(), rom)) local.push_back(std::move(rom));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                for (auto& w : found) queue.push_back(std::move(w));
+                --busy;
+            }
+            queueChanged.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& r : local) results.push_back(std::move(r));
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    return results;
+}
+
+// ===========================
+// Catalog file
+// ===========================
+bool writeCatalog(const std::string& path, std::vector<ScannedRom> roms) {
+    // Same content together, the preferred copy (NES 2.0, then path) first
+    std::sort(roms.begin(), roms.end(), [](const ScannedRom& a, const ScannedRom& b) {
+        if (entryLess(a.entry, b.entry)) return true;
+        if (entryLess(b.entry, a.entry)) return false;
+        bool a2 = (a.entry.flags & CATALOG_NES2) != 0;
+        bool b2 = (b.entry.flags & CATALOG_NES2) != 0;
+        if (a2 != b2) return a2;
+        return a.path < b.path;
+    });
+
+    std::vector<CatalogEntry> entries;
+    std::string strings;
+    entries.reserve(roms.size());
+    for (const auto& r : roms) {
+        if (!entries.empty() && !entryLess(entries.back(), r.entry)) continue;  // duplicate
+        CatalogEntry e = r.entry;
+        e.pathOffset = uint32_t(strings.size());
+        strings.append(r.path);
+        strings.push_back('\0');
+        entries.push_back(e);
+    }
+
+    CatalogHeader header;
+    std::memcpy(header.magic, "NKDB", 4);
+    header.version = CATALOG_VERSION;
+    header.entrySize = uint16_t(sizeof(CatalogEntry));
+    header.count = uint32_t(entries.size());
+    header.stringsSize = uint32_t(strings.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create catalog: " << path << "\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+        std::streamsize(entries.size() * sizeof(CatalogEntry)));
+    out.write(strings.data(), std::streamsize(strings.size()));
+    if (!out) {
+        std::cerr << "Failed to write catalog: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool RomCatalog::open(const std::string& path) {
+    entries = nullptr;
+    count = 0;
+    strings = nullptr;
+    stringsSize = 0;
+    if (!file.open(path)) return false;
+
+    CatalogHeader header;
+    if (file.size() < sizeof(header)) {
+        std::cerr << "Not a catalog: " << path << "\n";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    size_t expected = sizeof(header) + size_t(header.count) * sizeof(CatalogEntry) + header.stringsSize;
+    if (std::memcmp(header.magic, "NKDB", 4) != 0 || header.version != CATALOG_VERSION ||
+        header.entrySize != sizeof(CatalogEntry) || file.size() != expected) {
+        std::cerr << "Not a supported catalog: " << path << "\n";
+        file.close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const CatalogEntry*>(file.data() + sizeof(header));
+    count = header.count;
+    strings = reinterpret_cast<const char*>(file.data() + sizeof(header) + count * sizeof(CatalogEntry));
+    stringsSize = header.stringsSize;
+    return true;
+}
+
+const char* RomCatalog::path(const CatalogEntry& e) const {
+    if (e.pathOffset >= stringsSize) return "";
+    return strings + e.pathOffset;
+}
+
+const CatalogEntry* RomCatalog::find(uint32_t crc, uint64_t xxhash) const {
+    CatalogEntry key = {};
+    key.crc32 = crc;
+    key.xxhash = xxhash;
+    const CatalogEntry* end = entries + count;
+    const CatalogEntry* it = std::lower_bound(entries, end, key, entryLess);
+    if (it == end || it->crc32 != crc || it->xxhash != xxhash) return nullptr;
+    return it;
+}
+
+const CatalogEntry* RomCatalog::findByName(const std::string& text) const {
+    auto lower = [](unsigned char c) { return char(std::tolower(c)); };
+    std::string needle = text;
+    std::transform(needle.begin(), needle.end(), needle.begin(), lower);
+
+    for (size_t i = 0; i < count; ++i) {
+        std::string name = fs::path(path(entries[i])).filename().string();
+        std::transform(name.begin(), name.end(), name.begin(), lower);
+        if (name.find(needle) != std::string::npos) return &entries[i];
+    }
+    return nullptr;
+}
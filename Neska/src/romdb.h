@@ -0,0 +1,88 @@
+// romdb.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+#include "rom.h"
+
+// ROM library catalog.
+//
+// A catalog file is a 16-byte header, an array of CatalogEntry sorted by
+// (crc32, xxhash), then a table of NUL-terminated paths. It is used
+// straight from a read-only mapping: opening it is a validity check and
+// a lookup is a binary search, so nothing is parsed at load time.
+
+// One distinct ROM. Fixed size so the array can be searched in place.
+struct CatalogEntry {
+    uint32_t crc32;          // PRG+CHR, same as RomImage::hash
+    uint32_t pathOffset;     // into the path table
+    uint64_t xxhash;         // XXH64 of PRG+CHR
+    uint32_t prgSize;
+    uint32_t chrSize;
+    uint32_t prgRamSize;
+    uint32_t prgNvramSize;
+    uint32_t chrRamSize;
+    uint32_t chrNvramSize;
+    uint16_t mapperID;
+    uint8_t  submapper;
+    uint8_t  mirror;         // MirrorMode
+    uint8_t  timing;         // RomTiming
+    uint8_t  consoleType;
+    uint8_t  flags;          // CATALOG_* bits
+    uint8_t  reserved;
+};
+static_assert(sizeof(CatalogEntry) == 48, "CatalogEntry is a file format");
+
+enum : uint8_t {
+    CATALOG_NES2    = 1 << 0,  // header came from an NES 2.0 file
+    CATALOG_BATTERY = 1 << 1,
+    CATALOG_TRAINER = 1 << 2,
+};
+
+CatalogEntry makeCatalogEntry(const RomHeader& header, uint32_t crc, uint64_t xxhash);
+RomHeader    catalogHeader(const CatalogEntry& entry);
+
+// A ROM file found by scanRomLibrary.
+struct ScannedRom {
+    std::string  path;
+    CatalogEntry entry;
+};
+
+// Walk 'roots' (directories, recursively, or single files) on 'threads'
+// workers (0 = one per core), parsing and hashing every .nes file.
+// Directories and files are shared work items, so one large directory
+// spreads across all workers. The result is in no particular order.
+std::vector<ScannedRom> scanRomLibrary(const std::vector<std::string>& roots,
+    unsigned threads = 0);
+
+// Sort and write a catalog. Identical PRG+CHR found under several names
+// is stored once, preferring an NES 2.0 header, so that loads of the
+// other copies pick up the better header. Prints why and returns false
+// on I/O failure.
+bool writeCatalog(const std::string& path, std::vector<ScannedRom> roms);
+
+class RomCatalog {
+public:
+    // Map and validate a catalog. Prints why and returns false on failure.
+    bool open(const std::string& path);
+
+    size_t              size() const { return count; }
+    const CatalogEntry& entry(size_t i) const { return entries[i]; }
+    const char*         path(const CatalogEntry& e) const;
+
+    // Exact content match, or nullptr.
+    const CatalogEntry* find(uint32_t crc, uint64_t xxhash) const;
+
+    // First entry whose file name contains 'text', ignoring case.
+    const CatalogEntry* findByName(const std::string& text) const;
+
+private:
+    MappedFile          file;
+    const CatalogEntry* entries = nullptr;
+    size_t              count = 0;
+    const char*         strings = nullptr;
+    size_t              stringsSize = 0;
+};
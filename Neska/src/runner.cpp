@@ -0,0 +1,140 @@
+// runner.cpp
+#include "runner.h"
+#include "machine.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+static void pinCurrentThread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+#else
+    (void)cpu;
+#endif
+}
+
+Runner::Runner(const RunnerConfig& cfg)
+    : config(cfg)
+{
+    if (config.workers == 0) {
+        config.workers = std::thread::hardware_concurrency();
+        if (config.workers == 0) config.workers = 1;
+    }
+    if (config.sliceFrames == 0) config.sliceFrames = 1;
+}
+
+void Runner::add(Machine& machine, uint64_t frameBudget, FrameHook hook) {
+    if (frameBudget == 0) return;
+    pending.push_back({ &machine, frameBudget, 0, std::move(hook) });
+}
+
+bool Runner::popLocal(unsigned worker, Task& out) {
+    WorkerQueue& q = *queues[worker];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (q.tasks.empty()) return false;
+    out = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool Runner::steal(unsigned thief, Task& out) {
+    const unsigned n = unsigned(queues.size());
+    for (unsigned i = 1; i < n; ++i) {
+        WorkerQueue& q = *queues[(thief + i) % n];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty()) continue;
+        // Take from the opposite end to the owner to keep contention low
+        out = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+RunnerStats Runner::run() {
+    RunnerStats stats;
+    const unsigned workers = config.workers;
+
+    queues.clear();
+    for (unsigned i = 0; i < workers; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    // Deal instances round-robin; stealing evens out the rest.
+    std::atomic<size_t> unfinished(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        queues[i % workers]->tasks.push_back(std::move(pending[i]));
+    }
+    pending.clear();
+
+    std::vector<uint64_t> workerFrames(workers, 0);
+    std::atomic<uint64_t> steals(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto workerMain = [&](unsigned id) {
+        if (config.pinWorkers) {
+            int cpu = config.cpus.empty() ? int(id) : config.cpus[id % config.cpus.size()];
+            pinCurrentThread(cpu);
+        }
+
+        uint64_t frames = 0;
+        Task task;
+        while (unfinished.load(std::memory_order_acquire) > 0) {
+            if (!popLocal(id, task)) {
+                if (!steal(id, task)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                steals.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            uint64_t slice = task.remaining < config.sliceFrames ? task.remaining : config.sliceFrames;
+            for (uint64_t f = 0; f < slice; ++f) {
+                if (task.hook) task.hook(*task.machine, task.done);
+                task.machine->runFrame();
+                task.done++;
+            }
+            task.remaining -= slice;
+            frames += slice;
+
+            if (task.remaining > 0) {
+                WorkerQueue& q = *queues[id];
+                std::lock_guard<std::mutex> guard(q.lock);
+                q.tasks.push_back(std::move(task));
+            }
+            else {
+                unfinished.fetch_sub(1, std::memory_order_release);
+            }
+        }
+        workerFrames[id] = frames;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back(workerMain, i);
+    }
+    for (auto& t : threads) t.join();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (uint64_t f : workerFrames) stats.frames += f;
+    stats.framesPerSecond = stats.seconds > 0 ? stats.frames / stats.seconds : 0.0;
+    stats.framesPerWorker = std::move(workerFrames);
+    stats.steals = steals.load();
+    return stats;
+}
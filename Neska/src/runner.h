@@ -0,0 +1,65 @@
+// runner.h
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Machine;
+
+struct RunnerConfig {
+    unsigned workers = 0;         // 0 = std::thread::hardware_concurrency()
+    bool     pinWorkers = false;  // pin worker i to cpus[i % cpus.size()]
+    std::vector<int> cpus;        // empty = 0..N-1
+    uint32_t sliceFrames = 60;    // frames a worker runs before re-queueing
+};
+
+struct RunnerStats {
+    uint64_t frames = 0;
+    double   seconds = 0.0;
+    double   framesPerSecond = 0.0;
+    std::vector<uint64_t> framesPerWorker;
+    uint64_t steals = 0;
+};
+
+// Runs many independent machines across a work-stealing thread pool.
+// Each instance is split into slices of 'sliceFrames' frames; a worker
+// runs slices from its own queue and steals from the others when it runs
+// dry, so instances that finish early don't leave cores idle.
+class Runner {
+public:
+    // Called before each frame, e.g. to feed input. Runs on a worker thread.
+    using FrameHook = std::function<void(Machine&, uint64_t frame)>;
+
+    explicit Runner(const RunnerConfig& config = RunnerConfig());
+
+    // Queue a machine to run for 'frameBudget' frames. The machine must
+    // outlive run() and must not be added twice.
+    void add(Machine& machine, uint64_t frameBudget, FrameHook hook = nullptr);
+
+    // Run every queued instance to completion and return aggregate stats.
+    RunnerStats run();
+
+private:
+    struct Task {
+        Machine*  machine;
+        uint64_t  remaining;
+        uint64_t  done;
+        FrameHook hook;
+    };
+
+    struct WorkerQueue {
+        std::mutex       lock;
+        std::deque<Task> tasks;
+    };
+
+    bool popLocal(unsigned worker, Task& out);
+    bool steal(unsigned thief, Task& out);
+
+    RunnerConfig config;
+    std::vector<Task> pending;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+};
@@ -0,0 +1,118 @@
+// savestate.h
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Snapshot container (little endian, native layout inside sections):
+//   header:  u32 magic "NKST", u16 version, u16 sectionCount,
+//            u32 romHash, u32 totalSize
+//   section: u32 tag, u32 size, 'size' bytes written by the component
+// A loader checks every known section's size against what this build
+// would write before touching any state, and skips unknown tags.
+static const uint16_t STATE_VERSION = 8;  // 5: APU section, 6: CPU cycle parity, 7: second controller,
+                                          // 8: CPU/PPU/RAM sections are raw state blocks
+
+constexpr uint32_t fourCC(const char (&s)[5]) {
+    return uint32_t(uint8_t(s[0])) | (uint32_t(uint8_t(s[1])) << 8) |
+        (uint32_t(uint8_t(s[2])) << 16) | (uint32_t(uint8_t(s[3])) << 24);
+}
+
+static const uint32_t STATE_MAGIC = fourCC("NKST");
+
+enum class StateSection : uint32_t {
+    Machine   = fourCC("MACH"),
+    CPU       = fourCC("CPU "),
+    PPU       = fourCC("PPU "),
+    Memory    = fourCC("RAM "),
+    Cartridge = fourCC("CART"),
+    APU       = fourCC("APU ")
+};
+
+struct StateHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sectionCount;
+    uint32_t romHash;
+    uint32_t totalSize;
+};
+
+// Sequential writer for machine snapshots. Components append their fields
+// in a fixed order; the reader consumes them in the same order. Writing to
+// a null buffer only measures, which is how snapshot sizes are computed.
+class StateWriter {
+public:
+    StateWriter(uint8_t* buffer, size_t capacity)
+        : buf(buffer), cap(capacity), pos(0) {}
+
+    void writeBytes(const void* data, size_t size) {
+        if (buf && pos + size <= cap) {
+            std::memcpy(buf + pos, data, size);
+        }
+        pos += size;
+    }
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state fields must be trivially copyable");
+        writeBytes(&value, sizeof(T));
+    }
+
+    // Overwrite a value written earlier (section sizes are patched in
+    // after the payload is known).
+    template <typename T>
+    void patch(size_t at, const T& value) {
+        if (buf && at + sizeof(T) <= cap) {
+            std::memcpy(buf + at, &value, sizeof(T));
+        }
+    }
+
+    size_t size() const { return pos; }
+    bool   overflowed() const { return pos > cap; }
+
+private:
+    uint8_t* buf;
+    size_t   cap;
+    size_t   pos;
+};
+
+class StateReader {
+public:
+    StateReader(const uint8_t* buffer, size_t size)
+        : buf(buffer), len(size), pos(0), bad(false) {}
+
+    void readBytes(void* data, size_t size) {
+        if (bad || pos + size > len) {
+            bad = true;
+            return;
+        }
+        std::memcpy(data, buf + pos, size);
+        pos += size;
+    }
+
+    template <typename T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state fields must be trivially copyable");
+        readBytes(&value, sizeof(T));
+    }
+
+    void skip(size_t size) {
+        if (bad || pos + size > len) {
+            bad = true;
+            return;
+        }
+        pos += size;
+    }
+
+    size_t position() const { return pos; }
+    size_t remaining() const { return len - pos; }
+    bool   failed() const { return bad; }
+
+private:
+    const uint8_t* buf;
+    size_t         len;
+    size_t         pos;
+    bool           bad;
+};
@@ -0,0 +1,77 @@
+// scheduler.h
+#pragma once
+
+#include <cstdint>
+
+// Things the emulator has to act on at a known CPU cycle. When several
+// are due on the same cycle they run in this order.
+enum class EventType : uint8_t {
+    DmaStall,         // OAM or DMC DMA took the bus: run the PPU alone
+    VBlank,           // PPU dot 241,1: deliver the NMI
+    FrameEnd,         // PPU wrapped back to dot 0,0
+    ScanlineCounter,  // PPU A12 rise for mapper scanline IRQ counters
+    Apu,              // APU IRQ or DMC sample fetch (APU::nextCpuEvent)
+    Count
+};
+
+// Deadlines on the 64-bit CPU cycle clock (CPU::totalCycles), one per
+// event type. The emulator runs the CPU and PPU without checking anything
+// until next() and then pops what is due; components reschedule their own
+// event whenever its time changes. With this few event types a slot per
+// type and a cached minimum is the cheapest priority queue: reading the
+// next deadline is one load, and only moving the earliest event rescans.
+class Scheduler {
+public:
+    static constexpr uint64_t NEVER = ~uint64_t(0);
+
+    Scheduler() { clear(); }
+
+    // Set (or move) the deadline of 'type'. A cycle at or before the
+    // current one is due as soon as the running cycle ends.
+    void schedule(EventType type, uint64_t cycle) {
+        int slot = int(type);
+        bool wasNext = slot == nextSlot;
+        times[slot] = cycle;
+        if (cycle < nextTime || (cycle == nextTime && slot < nextSlot)) {
+            nextTime = cycle;
+            nextSlot = slot;
+        }
+        else if (wasNext) {
+            findNext();
+        }
+    }
+    void cancel(EventType type) { schedule(type, NEVER); }
+
+    uint64_t next() const { return nextTime; }
+    uint64_t time(EventType type) const { return times[int(type)]; }
+
+    // Remove the earliest event due at 'now' into 'type'; false if none.
+    bool pop(uint64_t now, EventType& type) {
+        if (nextTime > now) return false;
+        type = EventType(nextSlot);
+        times[nextSlot] = NEVER;
+        findNext();
+        return true;
+    }
+
+    void clear() {
+        for (uint64_t& t : times) t = NEVER;
+        nextTime = NEVER;
+        nextSlot = 0;
+    }
+
+private:
+    static const int SLOTS = int(EventType::Count);
+
+    void findNext() {
+        nextSlot = 0;
+        for (int i = 1; i < SLOTS; ++i) {
+            if (times[i] < times[nextSlot]) nextSlot = i;
+        }
+        nextTime = times[nextSlot];
+    }
+
+    uint64_t times[SLOTS];
+    uint64_t nextTime;
+    int      nextSlot;
+};
@@ -0,0 +1,45 @@
+// tracering.cpp
+#include "tracering.h"
+#include <cstdio>
+
+TraceRing::TraceRing(size_t capacity)
+    : head(0), tail(0), droppedCount(0)
+{
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    events.resize(size);
+    mask = size - 1;
+}
+
+size_t TraceRing::pop(TraceEvent* out, size_t max) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t available = head.load(std::memory_order_acquire) - t;
+    size_t count = available < max ? available : max;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = events[(t + i) & mask];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return count;
+}
+
+size_t formatTraceEvent(const TraceEvent& e, char* out, size_t size) {
+    int n = 0;
+    switch (TraceCategory(e.category)) {
+    case TraceCategory::PPU:
+        n = std::snprintf(out, size, "%12llu PPU  write $%04X = $%02X\n",
+            (unsigned long long)e.cycle, unsigned(e.arg0), unsigned(e.arg1));
+        break;
+    case TraceCategory::Interrupt:
+        n = std::snprintf(out, size, "%12llu INT  %s at scanline %u dot %u\n",
+            (unsigned long long)e.cycle, e.code == TRACE_NMI ? "NMI" : "IRQ",
+            unsigned(e.arg0), unsigned(e.arg1));
+        break;
+    default:
+        n = std::snprintf(out, size, "%12llu ?%u.%u %04X %08X\n",
+            (unsigned long long)e.cycle, unsigned(e.category), unsigned(e.code),
+            unsigned(e.arg0), unsigned(e.arg1));
+        break;
+    }
+    if (n < 0) return 0;
+    return size_t(n) < size ? size_t(n) : size - 1;
+}
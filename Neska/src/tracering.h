@@ -0,0 +1,88 @@
+// tracering.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Event categories. Each one is a bit in NESKA_TRACE_MASK.
+enum class TraceCategory : uint8_t {
+    PPU       = 0,  // register writes ($2000-$2007)
+    Interrupt = 1,  // NMI/IRQ raised
+    Count
+};
+
+// Compile-time category filter. Calls for categories outside the mask are
+// discarded by 'if constexpr' and leave nothing behind in the hot path.
+// Debug builds trace everything by default, release builds nothing; pass
+// -DNESKA_TRACE_MASK=... to choose explicitly.
+#ifndef NESKA_TRACE_MASK
+#ifdef NDEBUG
+#define NESKA_TRACE_MASK 0u
+#else
+#define NESKA_TRACE_MASK 0xFFFFFFFFu
+#endif
+#endif
+
+constexpr bool traceCategoryEnabled(TraceCategory c) {
+    return (uint32_t(NESKA_TRACE_MASK) >> uint32_t(c)) & 1u;
+}
+
+// Event codes within a category.
+enum TraceCode : uint8_t {
+    TRACE_PPU_WRITE = 0,   // arg0 = register address, arg1 = value
+    TRACE_NMI = 0,         // arg0 = scanline, arg1 = dot
+    TRACE_IRQ = 1
+};
+
+// One fixed-size record. No strings: formatting happens on the consumer.
+struct TraceEvent {
+    uint64_t cycle;     // CPU cycle timestamp
+    uint8_t  category;  // TraceCategory
+    uint8_t  code;      // TraceCode within the category
+    uint16_t arg0;
+    uint32_t arg1;
+};
+static_assert(sizeof(TraceEvent) == 16, "TraceEvent must stay 16 bytes");
+
+// Preallocated single-producer/single-consumer ring of trace events. The
+// emulation thread pushes, whoever drains the log pops; neither side locks
+// or allocates. A full ring drops the new event and counts it rather than
+// stalling emulation.
+class TraceRing {
+public:
+    // 'capacity' is rounded up to a power of two.
+    explicit TraceRing(size_t capacity = 1 << 14);
+
+    TraceRing(const TraceRing&) = delete;
+    TraceRing& operator=(const TraceRing&) = delete;
+
+    // Producer.
+    bool push(const TraceEvent& e) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        events[h & mask] = e;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: copy up to 'max' events out, oldest first. Returns the count.
+    size_t pop(TraceEvent* out, size_t max);
+
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<TraceEvent> events;
+    size_t mask;
+    alignas(64) std::atomic<size_t>   head;
+    alignas(64) std::atomic<size_t>   tail;
+    alignas(64) std::atomic<uint64_t> droppedCount;
+};
+
+// Render one event as a single text line ending in '\n'. Returns the
+// number of characters written (truncated to 'size').
+size_t formatTraceEvent(const TraceEvent& e, char* out, size_t size);
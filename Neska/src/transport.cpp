@@ -0,0 +1,160 @@
+// transport.cpp
+#include "transport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// ---------------------------------------------------------------------
+// UdpTransport
+// ---------------------------------------------------------------------
+#if defined(_WIN32)
+static const uintptr_t NO_SOCKET = uintptr_t(INVALID_SOCKET);
+
+static bool startWinsock() {
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+
+static void closeSocket(uintptr_t s) { closesocket(SOCKET(s)); }
+#else
+static const int NO_SOCKET = -1;
+
+static void closeSocket(int s) { ::close(s); }
+#endif
+
+UdpTransport::~UdpTransport() {
+    close();
+}
+
+bool UdpTransport::isOpen() const {
+    return sock != NO_SOCKET;
+}
+
+bool UdpTransport::open(uint16_t localPort, const std::string& peerHost, uint16_t peerPortHost) {
+    close();
+#if defined(_WIN32)
+    if (!startWinsock()) {
+        std::cerr << "Unable to start Winsock\n";
+        return false;
+    }
+#endif
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(peerHost.c_str(), nullptr, &hints, &found) != 0 || !found) {
+        std::cerr << "Unknown netplay peer: " << peerHost << "\n";
+        return false;
+    }
+    peerAddr = reinterpret_cast<const sockaddr_in*>(found->ai_addr)->sin_addr.s_addr;
+    peerPort = htons(peerPortHost);
+    freeaddrinfo(found);
+
+    auto s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == decltype(s)(NO_SOCKET)) {
+        std::cerr << "Unable to create UDP socket\n";
+        return false;
+    }
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if (::bind(s, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0) {
+        std::cerr << "Unable to bind UDP port " << localPort << "\n";
+        closeSocket(s);
+        return false;
+    }
+
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    bool ok = ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    bool ok = flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        std::cerr << "Unable to make the UDP socket non-blocking\n";
+        closeSocket(s);
+        return false;
+    }
+
+    sock = decltype(sock)(s);
+    return true;
+}
+
+void UdpTransport::close() {
+    if (sock != NO_SOCKET) {
+        closeSocket(sock);
+        sock = NO_SOCKET;
+    }
+}
+
+bool UdpTransport::send(const uint8_t* data, size_t size) {
+    if (sock == NO_SOCKET) return false;
+    sockaddr_in to;
+    std::memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = peerAddr;
+    to.sin_port = peerPort;
+    auto n = ::sendto(sock, reinterpret_cast<const char*>(data), int(size), 0,
+        reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+    return n == decltype(n)(size);
+}
+
+size_t UdpTransport::receive(uint8_t* data, size_t capacity) {
+    if (sock == NO_SOCKET) return 0;
+    for (;;) {
+        sockaddr_in from;
+        socklen_t fromSize = sizeof(from);
+        auto n = ::recvfrom(sock, reinterpret_cast<char*>(data), int(capacity), 0,
+            reinterpret_cast<sockaddr*>(&from), &fromSize);
+        // Nothing waiting (or an ICMP error from a peer not yet listening)
+        if (n <= 0) return 0;
+        if (from.sin_addr.s_addr == peerAddr && from.sin_port == peerPort) return size_t(n);
+    }
+}
+
+// ---------------------------------------------------------------------
+// LoopbackLink
+// ---------------------------------------------------------------------
+LoopbackLink::LoopbackLink(uint32_t delay, uint32_t dropEvery)
+    : ends{ Endpoint(*this, 0), Endpoint(*this, 1) },
+    now(0), sent{ 0, 0 }, delay(delay), dropEvery(dropEvery)
+{
+}
+
+bool LoopbackLink::Endpoint::send(const uint8_t* data, size_t size) {
+    uint64_t n = ++link.sent[side];
+    if (link.dropEvery && n % link.dropEvery == 0) return true;  // lost on the way
+    link.inbox[side ^ 1].push_back({ link.now + link.delay, std::vector<uint8_t>(data, data + size) });
+    return true;
+}
+
+size_t LoopbackLink::Endpoint::receive(uint8_t* data, size_t capacity) {
+    std::deque<Packet>& q = link.inbox[side];
+    if (q.empty() || q.front().due > link.now) return 0;
+    size_t size = std::min(capacity, q.front().data.size());
+    std::memcpy(data, q.front().data.data(), size);
+    q.pop_front();
+    return size;
+}
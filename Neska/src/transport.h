@@ -0,0 +1,96 @@
+// transport.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Unreliable, unordered datagrams between two netplay peers. Whatever
+// runs on top (NetplaySession) repeats what it needs until acknowledged,
+// so an implementation may drop, delay or reorder packets.
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Queue one datagram for the peer; false if it could not be sent.
+    virtual bool send(const uint8_t* data, size_t size) = 0;
+
+    // Copy the next received datagram into 'data' (truncated to
+    // 'capacity') and return its size, or 0 when none is waiting. Never
+    // blocks.
+    virtual size_t receive(uint8_t* data, size_t capacity) = 0;
+};
+
+// UDP socket bound to a local port, talking to one peer address
+// (usually 127.0.0.1 for sessions between processes on one host).
+// Datagrams from any other address are ignored.
+class UdpTransport : public Transport {
+public:
+    UdpTransport() = default;
+    ~UdpTransport() override;
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    // Bind 'localPort' and aim at 'peerHost':'peerPort' (IPv4 name or
+    // address). Prints why and returns false on failure.
+    bool open(uint16_t localPort, const std::string& peerHost, uint16_t peerPort);
+    void close();
+    bool isOpen() const;
+
+    bool   send(const uint8_t* data, size_t size) override;
+    size_t receive(uint8_t* data, size_t capacity) override;
+
+private:
+#if defined(_WIN32)
+    uintptr_t sock = ~uintptr_t(0);  // SOCKET
+#else
+    int sock = -1;
+#endif
+    uint32_t peerAddr = 0;   // network byte order
+    uint16_t peerPort = 0;   // network byte order
+};
+
+// Deterministic in-process stand-in for a network: two endpoints joined
+// by queues. A packet becomes receivable 'delay' ticks after it was sent,
+// and every 'dropEvery'-th packet (0 = none) in each direction is lost,
+// so checks such as tools/neska_netcheck see the same latency and loss
+// pattern on every run.
+class LoopbackLink {
+public:
+    explicit LoopbackLink(uint32_t delay = 0, uint32_t dropEvery = 0);
+
+    LoopbackLink(const LoopbackLink&) = delete;
+    LoopbackLink& operator=(const LoopbackLink&) = delete;
+
+    // Endpoint 0 or 1; what one sends the other receives.
+    Transport& endpoint(int side) { return ends[side & 1]; }
+
+    // Advance the link clock by one tick (typically one frame).
+    void tick() { now++; }
+
+private:
+    struct Packet {
+        uint64_t             due;
+        std::vector<uint8_t> data;
+    };
+
+    class Endpoint : public Transport {
+    public:
+        Endpoint(LoopbackLink& link, int side) : link(link), side(side) {}
+        bool   send(const uint8_t* data, size_t size) override;
+        size_t receive(uint8_t* data, size_t capacity) override;
+    private:
+        LoopbackLink& link;
+        int           side;
+    };
+
+    std::deque<Packet> inbox[2];   // packets waiting for side i
+    Endpoint ends[2];
+    uint64_t now;
+    uint64_t sent[2];   // packets sent by side i, for the loss pattern
+    uint32_t delay;
+    uint32_t dropEvery;
+};
@@ -0,0 +1,136 @@
+// neska_audiobench.cpp
+//
+// Measures audio synthesis throughput.
+//
+//   neska_audiobench [--seconds S] [--rate HZ] [--edges N]
+//       Render S seconds of emulated audio (default 60) at HZ (default
+//       48000) with every BlipBuffer kernel this CPU supports, from N
+//       synthetic steps per video frame (default 2000), then through the
+//       whole APU with four channels playing. Prints emulated seconds,
+//       output samples and steps per wall-clock second.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "apu.h"
+#include "blipbuffer.h"
+
+// CPU cycles in one NTSC video frame, rounded
+static const uint32_t FRAME_CYCLES = 29781;
+
+struct BenchResult {
+    double seconds;
+    size_t samples;
+    size_t steps;
+};
+
+static void printResult(const char* name, double emulated, const BenchResult& r) {
+    std::printf("%-8s %8.1fx realtime  %7.2f Msamples/s", name,
+        emulated / r.seconds, r.samples / r.seconds / 1e6);
+    if (r.steps) std::printf("  %7.2f Msteps/s", r.steps / r.seconds / 1e6);
+    std::printf("\n");
+}
+
+static BenchResult benchKernel(BlipKernel kernel, int frames, int rate, uint32_t edges) {
+    BlipBuffer blip;
+    blip.setKernel(kernel);
+    blip.setRates(CPU_CLOCK_NTSC, rate);
+
+    // A fixed pseudo-random step pattern, replayed each frame
+    std::vector<BlipBuffer::Delta> pattern(edges);
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < edges; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        pattern[i].time = uint32_t(uint64_t(i) * FRAME_CYCLES / edges);
+        pattern[i].delta = (i & 1 ? -1.0f : 1.0f) * float(seed >> 24) / 2048.0f;
+    }
+
+    std::vector<int16_t> out(size_t(rate) / 10);
+    BenchResult r = { 0, 0, 0 };
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        for (const BlipBuffer::Delta& d : pattern) blip.addDelta(d.time, d.delta);
+        blip.endFrame(FRAME_CYCLES);
+        r.samples += blip.readSamples(out.data(), out.size());
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.steps = size_t(frames) * edges;
+    return r;
+}
+
+static BenchResult benchApu(int frames, int rate) {
+    APU apu;
+    apu.reset();
+    apu.setSampleRate(rate);
+    apu.writeRegister(0x4015, 0x0F);
+    // Pulse 1 at about 440 Hz, pulse 2 an octave up, triangle, noise
+    apu.writeRegister(0x4000, 0xBF);
+    apu.writeRegister(0x4002, 0xFD);
+    apu.writeRegister(0x4003, 0x08);
+    apu.writeRegister(0x4004, 0x7F);
+    apu.writeRegister(0x4006, 0x7E);
+    apu.writeRegister(0x4007, 0x08);
+    apu.writeRegister(0x4008, 0xFF);
+    apu.writeRegister(0x400A, 0x7E);
+    apu.writeRegister(0x400B, 0x08);
+    apu.writeRegister(0x400C, 0x3F);
+    apu.writeRegister(0x400E, 0x04);
+    apu.writeRegister(0x400F, 0x08);
+    apu.writeRegister(0x4017, 0x40);
+
+    std::vector<int16_t> out(size_t(rate) / 10);
+    BenchResult r = { 0, 0, 0 };
+    uint64_t cycle = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        cycle += FRAME_CYCLES;
+        apu.endFrame(cycle);
+        r.samples += apu.readSamples(out.data(), out.size());
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = 60.0;
+    int rate = 48000;
+    uint32_t edges = 2000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--edges") == 0 && i + 1 < argc) {
+            edges = uint32_t(std::atoi(argv[++i]));
+        }
+        else {
+            std::cerr << "Usage: neska_audiobench [--seconds S] [--rate HZ] [--edges N]\n";
+            return 2;
+        }
+    }
+    if (seconds <= 0 || rate <= 0) {
+        std::cerr << "Seconds and rate must be positive\n";
+        return 2;
+    }
+
+    int frames = int(seconds * CPU_CLOCK_NTSC / FRAME_CYCLES);
+    double emulated = double(frames) * FRAME_CYCLES / CPU_CLOCK_NTSC;
+    std::printf("%.0f s of audio at %d Hz, %u steps per frame\n", emulated, rate, edges);
+
+    BlipBuffer probe;
+    std::printf("auto kernel: %s\n", BlipBuffer::kernelName(probe.kernel()));
+    for (BlipKernel k : { BlipKernel::Scalar, BlipKernel::SSE, BlipKernel::AVX }) {
+        if (!probe.setKernel(k)) {
+            std::printf("%-8s unsupported\n", BlipBuffer::kernelName(k));
+            continue;
+        }
+        printResult(BlipBuffer::kernelName(k), emulated, benchKernel(k, frames, rate, edges));
+    }
+    printResult("APU", emulated, benchApu(frames, rate));
+    return 0;
+}
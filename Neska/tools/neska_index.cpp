@@ -0,0 +1,109 @@
+// neska_index.cpp
+//
+// Builds and queries ROM library catalogs (romdb.h).
+//
+//   neska_index build <catalog.nkdb> <dir|file>... [--threads N]
+//       Scan directories recursively in parallel and write a catalog.
+//
+//   neska_index list <catalog.nkdb>
+//       Print every entry.
+//
+//   neska_index lookup <catalog.nkdb> <rom.nes>
+//       Hash a ROM and print its catalog entry, if any.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "checksum.h"
+#include "romdb.h"
+
+static const char* mirrorName(uint8_t mirror) {
+    switch (MirrorMode(mirror)) {
+    case MirrorMode::HORIZONTAL:          return "H";
+    case MirrorMode::VERTICAL:            return "V";
+    case MirrorMode::FOUR_SCREEN:         return "4";
+    case MirrorMode::SINGLE_SCREEN:       return "1";
+    case MirrorMode::SINGLE_SCREEN_UPPER: return "1";
+    }
+    return "?";
+}
+
+static const char* timingName(uint8_t timing) {
+    static const char* names[] = { "NTSC", "PAL", "Multi", "Dendy" };
+    return timing < 4 ? names[timing] : "?";
+}
+
+static void printEntry(const CatalogEntry& e, const char* path) {
+    std::printf("%08X  %4u.%-2u %5uK %5uK  ram %3uK nv %3uK  %s %-5s %s%s  %s\n",
+        e.crc32, e.mapperID, e.submapper, e.prgSize / 1024, e.chrSize / 1024,
+        (e.prgRamSize + e.chrRamSize) / 1024, (e.prgNvramSize + e.chrNvramSize) / 1024,
+        mirrorName(e.mirror), timingName(e.timing),
+        (e.flags & CATALOG_NES2) ? "2" : "1", (e.flags & CATALOG_BATTERY) ? "B" : "-",
+        path);
+}
+
+static int buildCatalog(const std::string& out, const std::vector<std::string>& roots, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ScannedRom> roms = scanRomLibrary(roots, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t files = roms.size();
+    if (!writeCatalog(out, std::move(roms))) return 1;
+
+    RomCatalog catalog;
+    if (!catalog.open(out)) return 1;
+    std::cout << "Indexed " << files << " files (" << catalog.size() << " distinct) in "
+        << seconds << " s\n";
+    return 0;
+}
+
+static int listCatalog(const std::string& path) {
+    RomCatalog catalog;
+    if (!catalog.open(path)) return 1;
+    for (size_t i = 0; i < catalog.size(); ++i) {
+        printEntry(catalog.entry(i), catalog.path(catalog.entry(i)));
+    }
+    return 0;
+}
+
+static int lookupRom(const std::string& path, const std::string& romPath) {
+    RomCatalog catalog;
+    if (!catalog.open(path)) return 2;
+    auto rom = loadRomImage(romPath);
+    if (!rom) return 2;
+    uint64_t xxh = xxhash64(rom->prg.data, rom->prg.size + rom->chr.size);
+    const CatalogEntry* e = catalog.find(rom->hash, xxh);
+    if (!e) {
+        std::printf("%08X not in catalog\n", rom->hash);
+        return 1;
+    }
+    printEntry(*e, catalog.path(*e));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string command = argc >= 2 ? argv[1] : "";
+    if (command == "build" && argc >= 4) {
+        std::vector<std::string> roots;
+        unsigned threads = 0;
+        for (int i = 3; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) threads = unsigned(std::atoi(argv[++i]));
+            else roots.push_back(arg);
+        }
+        return buildCatalog(argv[2], roots, threads);
+    }
+    if (command == "list" && argc >= 3) {
+        return listCatalog(argv[2]);
+    }
+    if (command == "lookup" && argc >= 4) {
+        return lookupRom(argv[2], argv[3]);
+    }
+
+    std::cerr << "usage: neska_index build <catalog.nkdb> <dir|file>... [--threads N]\n"
+        "       neska_index list <catalog.nkdb>\n"
+        "       neska_index lookup <catalog.nkdb> <rom.nes>\n";
+    return 2;
+}
@@ -0,0 +1,198 @@
+// neska_trace.cpp
+//
+// Offline companion to --cpu-trace.
+//
+//   neska_trace format <trace.nkct> [out.log]
+//       Convert a binary CPU trace to nestest.log text.
+//
+//   neska_trace diff <actual> <expected> [--no-ppu] [--no-cycles] [--cycle-offset N]
+//       Compare two traces (binary .nkct or nestest-style text, in any
+//       combination) and report the first diverging instruction.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "cputrace.h"
+
+// The fields of one trace line that are compared.
+struct TraceLine {
+    unsigned pc = 0;
+    unsigned bytes[3] = {};
+    int      length = 0;
+    unsigned a = 0, x = 0, y = 0, p = 0, sp = 0;
+    int      scanline = -1, dot = -1;
+    long long cycle = -1;
+    std::string text;
+};
+
+// Pulls successive lines from either a binary trace or a text log.
+class TraceSource {
+public:
+    bool open(const std::string& path) {
+        std::ifstream probe(path, std::ios::binary);
+        char magic[4] = {};
+        probe.read(magic, 4);
+        binary = probe && std::memcmp(magic, "NKCT", 4) == 0;
+        if (binary) return reader.open(path);
+
+        text.open(path);
+        if (!text) {
+            std::cerr << "Failed to open " << path << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool next(TraceLine& line) {
+        if (binary) {
+            CpuTraceRecord r;
+            uint64_t cycle;
+            if (!reader.next(r, cycle)) return false;
+            char buf[128];
+            size_t n = formatNestestLine(r, cycle, buf, sizeof(buf));
+            if (n > 0 && buf[n - 1] == '\n') n--;
+            line.text.assign(buf, n);
+        }
+        else {
+            do {
+                if (!std::getline(text, line.text)) return false;
+                if (!line.text.empty() && line.text.back() == '\r') line.text.pop_back();
+            } while (line.text.empty());
+        }
+        return parse(line);
+    }
+
+private:
+    // nestest columns: PC at 0, opcode bytes at 6..13, registers by label
+    static bool parse(TraceLine& line) {
+        const std::string& s = line.text;
+        if (s.size() < 16) return false;
+        line.pc = unsigned(std::strtoul(s.substr(0, 4).c_str(), nullptr, 16));
+        line.length = 0;
+        for (int i = 0; i < 3; ++i) {
+            std::string b = s.substr(6 + i * 3, 2);
+            if (b[0] == ' ') break;
+            line.bytes[line.length++] = unsigned(std::strtoul(b.c_str(), nullptr, 16));
+        }
+        auto field = [&](const char* label, int base, long long& out) {
+            size_t at = s.find(label, 48);
+            if (at == std::string::npos) return false;
+            out = std::strtoll(s.c_str() + at + std::strlen(label), nullptr, base);
+            return true;
+        };
+        long long v;
+        if (field("A:", 16, v))   line.a = unsigned(v);
+        if (field("X:", 16, v))   line.x = unsigned(v);
+        if (field("Y:", 16, v))   line.y = unsigned(v);
+        if (field("P:", 16, v))   line.p = unsigned(v);
+        if (field("SP:", 16, v))  line.sp = unsigned(v);
+        if (field("CYC:", 10, v)) line.cycle = v;
+        size_t ppu = s.find("PPU:", 48);
+        if (ppu != std::string::npos) {
+            line.scanline = std::atoi(s.c_str() + ppu + 4);
+            size_t comma = s.find(',', ppu);
+            if (comma != std::string::npos) line.dot = std::atoi(s.c_str() + comma + 1);
+        }
+        return true;
+    }
+
+    bool           binary = false;
+    CpuTraceReader reader;
+    std::ifstream  text;
+};
+
+static int formatTrace(const std::string& in, const std::string& outPath) {
+    CpuTraceReader reader;
+    if (!reader.open(in)) return 1;
+
+    std::unique_ptr<std::ofstream> file;
+    if (!outPath.empty()) {
+        file = std::make_unique<std::ofstream>(outPath, std::ios::binary);
+        if (!*file) {
+            std::cerr << "Failed to create " << outPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = file ? *file : std::cout;
+
+    // Format into a large block and write it in one go
+    std::string block;
+    block.reserve(1 << 20);
+    CpuTraceRecord r;
+    uint64_t cycle;
+    char line[128];
+    while (reader.next(r, cycle)) {
+        block.append(line, formatNestestLine(r, cycle, line, sizeof(line)));
+        if (block.size() > (1 << 20) - 128) {
+            out.write(block.data(), std::streamsize(block.size()));
+            block.clear();
+        }
+    }
+    out.write(block.data(), std::streamsize(block.size()));
+    return 0;
+}
+
+static int diffTraces(const std::string& actualPath, const std::string& expectedPath,
+    bool comparePPU, bool compareCycles, long long cycleOffset) {
+    TraceSource actual, expected;
+    if (!actual.open(actualPath) || !expected.open(expectedPath)) return 2;
+
+    TraceLine a, e;
+    uint64_t index = 0;
+    for (;; ++index) {
+        bool haveA = actual.next(a);
+        bool haveE = expected.next(e);
+        if (!haveA && !haveE) break;
+        if (haveA != haveE) {
+            std::cout << (haveA ? expectedPath : actualPath) << " ends after "
+                << index << " instructions\n";
+            return 1;
+        }
+
+        const char* what = nullptr;
+        if (a.pc != e.pc) what = "PC";
+        else if (a.length != e.length || std::memcmp(a.bytes, e.bytes, sizeof(a.bytes)) != 0) what = "opcode bytes";
+        else if (a.a != e.a) what = "A";
+        else if (a.x != e.x) what = "X";
+        else if (a.y != e.y) what = "Y";
+        else if (a.p != e.p) what = "P";
+        else if (a.sp != e.sp) what = "SP";
+        else if (comparePPU && (a.scanline != e.scanline || a.dot != e.dot)) what = "PPU";
+        else if (compareCycles && a.cycle + cycleOffset != e.cycle) what = "CYC";
+
+        if (what) {
+            std::cout << "First divergence at instruction " << index + 1 << " (" << what << ")\n"
+                << "  expected: " << e.text << "\n"
+                << "  actual:   " << a.text << "\n";
+            return 1;
+        }
+    }
+    std::cout << "Traces match (" << index << " instructions)\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::string(argv[1]) == "format") {
+        return formatTrace(argv[2], argc >= 4 ? argv[3] : "");
+    }
+    if (argc >= 4 && std::string(argv[1]) == "diff") {
+        bool comparePPU = true;
+        bool compareCycles = true;
+        long long cycleOffset = 0;
+        for (int i = 4; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--no-ppu")         comparePPU = false;
+            else if (arg == "--no-cycles") compareCycles = false;
+            else if (arg == "--cycle-offset" && i + 1 < argc) cycleOffset = std::atoll(argv[++i]);
+        }
+        return diffTraces(argv[2], argv[3], comparePPU, compareCycles, cycleOffset);
+    }
+
+    std::cerr << "usage: neska_trace format <trace.nkct> [out.log]\n"
+        "       neska_trace diff <actual> <expected> [--no-ppu] [--no-cycles] [--cycle-offset N]\n";
+    return 2;
+}